@@ -13,13 +13,53 @@ namespace ApplicationConstants
     static constexpr auto INPUT_LONG{"input"};
     static constexpr auto OUTPUT_SHORT{"o"};
     static constexpr auto OUTPUT_LONG{"output"};
+    static constexpr auto MAX_MEMORY_LONG{"max-memory"};
+    static constexpr auto STORE_SHORT{"s"};
+    static constexpr auto STORE_LONG{"store"};
+    static constexpr auto PATTERN_SHORT{"p"};
+    static constexpr auto PATTERN_LONG{"pattern"};
+    static constexpr auto REGEX_LONG{"regex"};
+    static constexpr auto TIME_INDEX_LONG{"time-index"};
+    static constexpr auto FROM_LONG{"from"};
+    static constexpr auto TO_LONG{"to"};
+    static constexpr auto RESUME_LONG{"resume"};
+    static constexpr auto READ_ORDER_LONG{"read-order"};
+    static constexpr auto INTERVAL_LONG{"interval"};
+    static constexpr auto SNAPSHOT_LONG{"snapshot"};
 
-    static constexpr auto MODE_DESCRIPTION{"Operation mode: pack or unpack"};
-    static constexpr auto INPUT_DESCRIPTION{"Input directory or archive file"};
+    static constexpr auto MODE_DESCRIPTION{"Operation mode: pack, unpack, search or watch"};
+    static constexpr auto INPUT_DESCRIPTION{"Input directory or archive file, - unpacks an archive from standard input"};
     static constexpr auto OUTPUT_DESCRIPTION{"Output archive file or directory"};
+    static constexpr auto MAX_MEMORY_DESCRIPTION{"Memory budget for scanning in pack mode, e.g. 512M or 2G - "
+                                                 "files exceeding it are sorted on disk"};
+    static constexpr auto STORE_DESCRIPTION{"Shared blob store directory - file contents are deduplicated across "
+                                            "archives and the archive keeps only the index"};
+    static constexpr auto PATTERN_DESCRIPTION{"Text to search for in search mode"};
+    static constexpr auto REGEX_DESCRIPTION{"Treat the search pattern as a regular expression"};
+    static constexpr auto TIME_INDEX_DESCRIPTION{"Record the range of log timestamps of every file in pack mode - "
+                                                 "times are taken as written, UTC offsets are ignored"};
+    static constexpr auto FROM_DESCRIPTION{"Unpack only files with log events at or after this time, "
+                                           "e.g. \"2024-05-17 02:00\""};
+    static constexpr auto TO_DESCRIPTION{"Unpack only files with log events at or before this time"};
+    static constexpr auto RESUME_DESCRIPTION{"Continue an interrupted pack or watch update from its journal - in pack "
+                                             "mode the journal is only kept with this option"};
+    static constexpr auto READ_ORDER_DESCRIPTION{"Order of file reads in pack mode: physical (default), inode or scan - "
+                                                 "scan keeps the unscheduled order for comparison"};
+    static constexpr auto INTERVAL_DESCRIPTION{"Seconds between archive updates in watch mode, 300 by default"};
+    static constexpr auto SNAPSHOT_DESCRIPTION{"Write a new archive into the output directory on every update in watch "
+                                               "mode instead of appending to the output archive"};
 
     static constexpr auto MODE_PACK{"pack"};
     static constexpr auto MODE_UNPACK{"unpack"};
+    static constexpr auto MODE_SEARCH{"search"};
+    static constexpr auto MODE_WATCH{"watch"};
+
+    static constexpr auto READ_ORDER_PHYSICAL{"physical"};
+    static constexpr auto READ_ORDER_INODE{"inode"};
+    static constexpr auto READ_ORDER_SCAN{"scan"};
+
+    static constexpr auto STANDARD_INPUT{"-"};
+    static constexpr auto MEMORY_SUFFIXES{"KMGT"};
 }
 
 #endif // APPLICATIONCONSTANTS_H
@@ -0,0 +1,308 @@
+#include <QDebug>
+#include <QMutex>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+
+#include "ArchiveSearcher.h"
+#include "BlobStore.h"
+
+bool ArchiveSearcher::search(const QString &archivePath, const QString &pattern, const SearchOptions &options)
+{
+    LineMatcher matcher{pattern, options.regularExpression};
+
+    if (!matcher.isValid())
+    {
+        qCritical() << "Invalid search pattern:" << pattern;
+        return false;
+    }
+
+    QList<Archiver::FileMeta> metadataList;
+
+    if (!Archiver::readIndex(archivePath, metadataList))
+        return false;
+
+    // Archives packed in repository mode keep their data in the blob store
+    std::optional<BlobStore> blobStore;
+
+    if (!options.storePath.isEmpty())
+        blobStore.emplace(options.storePath);
+
+    QThreadPool       workers;
+    QMutex            outputMutex;
+    std::atomic<bool> failed{false};
+
+    if (options.threadCount > 0)
+        workers.setMaxThreadCount(options.threadCount);
+
+    for (const auto &blob : collectBlobs(metadataList))
+    {
+        QString blobPath;
+
+        if (blob.dataOffset == Archiver::s_storeOffset)
+        {
+            if (!blobStore)
+            {
+                qCritical() << "Archive references a blob store, but none was provided:" << archivePath;
+                failed = true;
+                break;
+            }
+
+            blobPath = blobStore->blobPath(blob.hash);
+        }
+
+        // Every blob is scanned once by a single worker, no matter how many paths reference it
+        workers.start([&, blob, blobPath]() {
+            if (failed)
+                return;
+
+            QList<Match> matches;
+
+            if (!scanBlob(archivePath, blob, blobPath, matcher, options.chunkSize, matches))
+            {
+                failed = true;
+                return;
+            }
+
+            if (matches.isEmpty())
+                return;
+
+            QMutexLocker locker{&outputMutex};
+
+            printMatches(blob, matches);
+        });
+    }
+
+    workers.waitForDone();
+
+    return !failed;
+}
+
+QList<ArchiveSearcher::Blob> ArchiveSearcher::collectBlobs(const QList<Archiver::FileMeta> &metadataList)
+{
+    QList<Blob>                                 blobs;
+    QHash<QPair<qint64, QByteArray>, qsizetype> blobIndexes;
+
+    for (const auto &meta : metadataList)
+    {
+        // Data inside the archive is identified by its offset, data in the store by its hash
+        auto isStored{meta.dataOffset == Archiver::s_storeOffset};
+        auto key{qMakePair(meta.dataOffset, isStored ? meta.hash : QByteArray{})};
+
+        if (auto it{blobIndexes.constFind(key)}; it != blobIndexes.constEnd())
+        {
+            blobs[it.value()].relativePaths.append(meta.relativePath);
+            continue;
+        }
+
+        blobIndexes.insert(key, blobs.size());
+
+        blobs.append(Blob{meta.dataOffset, meta.dataSize(), meta.hash, QStringList{meta.relativePath}, meta.holes});
+    }
+
+    return blobs;
+}
+
+bool ArchiveSearcher::scanBlob(const QString &archivePath,
+                               const Blob &blob,
+                               const QString &blobPath,
+                               const LineMatcher &matcher,
+                               qint64 chunkSize,
+                               QList<Match> &matches)
+{
+    auto  isStored{!blobPath.isEmpty()};
+    QFile dataFile{isStored ? blobPath : archivePath};
+
+    if (!dataFile.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Cannot open data of" << blob.relativePaths.first();
+        return false;
+    }
+
+    if (!isStored)
+        dataFile.seek(blob.dataOffset);
+
+    QByteArray pending;
+    qint64     lineNumber{1};
+    auto       bytesRemaining{blob.dataSize};
+    qint64     filePosition{0};
+    qsizetype  holeIndex{0};
+
+    while (bytesRemaining > 0)
+    {
+        // Holes hold only zeros, so no line breaks are lost. They are passed on as a single zero byte, so that text
+        // on both sides of a hole is not joined into false matches
+        if (holeIndex < blob.holes.size() && blob.holes.at(holeIndex).offset == filePosition)
+        {
+            pending.append('\0');
+            filePosition += blob.holes.at(holeIndex++).length;
+            continue;
+        }
+
+        auto readSize{qMin(bytesRemaining, chunkSize)};
+
+        if (holeIndex < blob.holes.size())
+            readSize = qMin(readSize, blob.holes.at(holeIndex).offset - filePosition);
+
+        auto chunk{dataFile.read(readSize)};
+
+        if (chunk.isEmpty())
+        {
+            qWarning() << "Unexpected end of archive while reading" << blob.relativePaths.first();
+            return false;
+        }
+
+        bytesRemaining -= chunk.size();
+        filePosition += chunk.size();
+        pending.append(chunk);
+
+        // Only whole lines are matched - the trailing partial line waits for the next chunk
+        auto regionSize{bytesRemaining > 0 ? pending.lastIndexOf('\n') + 1 : pending.size()};
+
+        // A line without breaks, e.g. of binary data, is matched in pieces instead of being buffered whole. Only
+        // the overlap which a match may share with the next piece is kept
+        if (regionSize == 0 && pending.size() > s_maxLineLength)
+        {
+            matcher.collect(pending, lineNumber, matches);
+            pending.remove(0, pending.size() - matcher.overlap());
+            continue;
+        }
+
+        if (regionSize == 0)
+            continue;
+
+        lineNumber += matcher.collect(QByteArray::fromRawData(pending.constData(), regionSize), lineNumber, matches);
+        pending.remove(0, regionSize);
+    }
+
+    return true;
+}
+
+void ArchiveSearcher::printMatches(const Blob &blob, const QList<Match> &matches)
+{
+    for (const auto &relativePath : blob.relativePaths)
+    {
+        auto prefix{relativePath.toUtf8() + ':'};
+
+        for (const auto &match : matches)
+        {
+            auto output{prefix + QByteArray::number(match.lineNumber) + ':' + match.line + '\n'};
+
+            std::fwrite(output.constData(), 1, static_cast<size_t>(output.size()), stdout);
+        }
+    }
+
+    std::fflush(stdout);
+}
+
+ArchiveSearcher::LineMatcher::LineMatcher(const QString &pattern, bool regularExpression)
+    : m_regularExpression{regularExpression}
+    , m_literal{pattern.toUtf8()}
+    , m_expression{regularExpression ? pattern : QString{}, QRegularExpression::MultilineOption}
+{
+    if (m_regularExpression)
+        m_expression.optimize();
+}
+
+bool ArchiveSearcher::LineMatcher::isValid() const
+{
+    return m_regularExpression ? m_expression.isValid() : !m_literal.pattern().isEmpty();
+}
+
+qsizetype ArchiveSearcher::LineMatcher::overlap() const
+{
+    // The extent of a regular expression's matches is unknown - those spanning two pieces are not found
+    return m_regularExpression ? 0 : m_literal.pattern().size() - 1;
+}
+
+qint64 ArchiveSearcher::LineMatcher::collect(const QByteArray &region, qint64 firstLineNumber, QList<Match> &matches) const
+{
+    return m_regularExpression ? collectRegularExpression(region, firstLineNumber, matches)
+                               : collectLiteral(region, firstLineNumber, matches);
+}
+
+qint64 ArchiveSearcher::LineMatcher::collectLiteral(const QByteArray &region, qint64 firstLineNumber, QList<Match> &matches) const
+{
+    const auto *data{region.constData()};
+    auto       size{region.size()};
+    auto       lineNumber{firstLineNumber};
+    qsizetype  counted{0};
+    qsizetype  from{0};
+
+    // The matcher skips over non-matching data, line breaks are only counted up to actual matches
+    while (from < size)
+    {
+        auto matchIndex{m_literal.indexIn(data, size, from)};
+
+        if (matchIndex < 0)
+            break;
+
+        auto lineStart{matchIndex};
+
+        while (lineStart > from && data[lineStart - 1] != '\n')
+            --lineStart;
+
+        const auto *lineBreak{static_cast<const char *>(std::memchr(data + matchIndex, '\n', size - matchIndex))};
+        auto       lineEnd{lineBreak ? lineBreak - data : size};
+
+        lineNumber += std::count(data + counted, data + lineStart, '\n');
+        counted = lineStart;
+
+        auto line{QByteArray{data + lineStart, lineEnd - lineStart}};
+
+        if (line.endsWith('\r'))
+            line.chop(1);
+
+        matches.append(Match{lineNumber, line});
+        from = lineEnd + 1;
+    }
+
+    lineNumber += std::count(data + counted, data + size, '\n');
+
+    return lineNumber - firstLineNumber;
+}
+
+qint64 ArchiveSearcher::LineMatcher::collectRegularExpression(const QByteArray &region,
+                                                             qint64 firstLineNumber,
+                                                             QList<Match> &matches) const
+{
+    // The whole region is decoded once so that the expression runs over it in a single pass
+    auto      text{QString::fromUtf8(region)};
+    auto      lineNumber{firstLineNumber};
+    qsizetype counted{0};
+    qsizetype from{0};
+
+    while (from < text.size())
+    {
+        auto match{m_expression.match(text, from)};
+
+        if (!match.hasMatch())
+            break;
+
+        auto matchIndex{match.capturedStart()};
+        auto lineStart{matchIndex > from ? text.lastIndexOf(QChar{'\n'}, matchIndex - 1) + 1 : from};
+        auto lineEnd{text.indexOf(QChar{'\n'}, matchIndex)};
+
+        if (lineEnd < 0)
+            lineEnd = text.size();
+
+        lineNumber += std::count(text.cbegin() + counted, text.cbegin() + lineStart, QChar{'\n'});
+        counted = lineStart;
+
+        auto line{text.mid(lineStart, lineEnd - lineStart).toUtf8()};
+
+        if (line.endsWith('\r'))
+            line.chop(1);
+
+        matches.append(Match{lineNumber, line});
+        from = lineEnd + 1;
+    }
+
+    lineNumber += std::count(text.cbegin() + counted, text.cend(), QChar{'\n'});
+
+    return lineNumber - firstLineNumber;
+}
@@ -0,0 +1,65 @@
+#ifndef ARCHIVESEARCHER_H
+#define ARCHIVESEARCHER_H
+
+#include <QByteArrayMatcher>
+#include <QRegularExpression>
+
+#include "Archiver.h"
+
+class ArchiveSearcher
+{
+public:
+    // Prints every line matching the pattern as path:line:text without extracting the archive
+    static bool search(const QString &archivePath, const QString &pattern, const SearchOptions &options);
+
+private:
+    struct Match
+    {
+        qint64     lineNumber;
+        QByteArray line;
+    };
+
+    // Deduplicated file contents together with every path that references them
+    struct Blob
+    {
+        qint64      dataOffset;
+        qint64      dataSize;
+        QByteArray  hash;
+        QStringList relativePaths;
+
+        QList<SparseFileCopier::Extent> holes; // Left out of the data, in order
+    };
+
+    class LineMatcher
+    {
+    public:
+        LineMatcher(const QString &pattern, bool regularExpression);
+
+        bool      isValid() const;
+        qsizetype overlap() const; // Bytes of a piece which a match may share with the next one
+
+        // Collects matching lines of a region made of whole lines, returns the number of line breaks in it
+        qint64 collect(const QByteArray &region, qint64 firstLineNumber, QList<Match> &matches) const;
+
+    private:
+        qint64 collectLiteral(const QByteArray &region, qint64 firstLineNumber, QList<Match> &matches) const;
+        qint64 collectRegularExpression(const QByteArray &region, qint64 firstLineNumber, QList<Match> &matches) const;
+
+        bool               m_regularExpression;
+        QByteArrayMatcher  m_literal;
+        QRegularExpression m_expression;
+    };
+
+    static QList<Blob> collectBlobs(const QList<Archiver::FileMeta> &metadataList);
+    static bool scanBlob(const QString &archivePath,
+                         const Blob &blob,
+                         const QString &blobPath,
+                         const LineMatcher &matcher,
+                         qint64 chunkSize,
+                         QList<Match> &matches);
+    static void printMatches(const Blob &blob, const QList<Match> &matches);
+
+    static constexpr qsizetype s_maxLineLength{1024 * 1024}; // Longer lines are matched in pieces
+};
+
+#endif // ARCHIVESEARCHER_H
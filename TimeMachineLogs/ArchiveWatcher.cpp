@@ -0,0 +1,94 @@
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+
+#include "ArchiveWatcher.h"
+#include "Archiver.h"
+#include "FileCollector.h"
+#include "PackJournal.h"
+#include "TreeWatcher.h"
+
+bool ArchiveWatcher::watch(const QString &inputDir, const QString &output, const WatchOptions &options)
+{
+    // Watching starts before the scan, so that files changing while it runs are not missed
+    TreeWatcher treeWatcher{inputDir};
+    auto        archivePath{options.snapshot ? snapshotPath(output) : output};
+    PackJournal journal{archivePath, inputDir, options.pack};
+    auto        packOptions{options.pack};
+
+    packOptions.journal = &journal;
+
+    if (!Archiver::validateArchivePathForPack(archivePath))
+        return false;
+
+    // The journal is opened before the scan, so that hashes of a resumed run are not calculated again. Snapshots
+    // are complete archives of their own, there is no earlier one to continue
+    if (!(options.resume && !options.snapshot ? journal.resume() : journal.start()))
+    {
+        qWarning() << "Cannot open the pack journal for: " << archivePath;
+        return false;
+    }
+
+    FileCollector fileCollector{inputDir, FileCollector::s_unlimitedMemory, &journal, options.readOrder};
+
+    if (!Archiver::pack(archivePath, fileCollector, packOptions))
+        return false;
+
+    // Finished along with the archive - every update keeps a journal of its own
+    fileCollector.setJournal(nullptr);
+
+    while (true)
+    {
+        auto changedPaths{treeWatcher.waitForChanges(options.interval)};
+
+        // Without reliable events the tree is compared with the collected files, which reads no file either
+        if (!changedPaths)
+            changedPaths = fileCollector.findChanges();
+
+        if (changedPaths->isEmpty())
+            continue;
+
+        fileCollector.update(*changedPaths);
+
+        if (!writeArchive(inputDir, output, fileCollector, *changedPaths, options))
+            return false;
+
+        qInfo() << "Archived" << changedPaths->size() << "changed paths of:" << inputDir;
+    }
+}
+
+bool ArchiveWatcher::writeArchive(const QString &inputDir,
+                                  const QString &output,
+                                  const FileCollector &fileCollector,
+                                  const QSet<QString> &changedPaths,
+                                  const WatchOptions &options)
+{
+    auto        archivePath{options.snapshot ? snapshotPath(output) : output};
+    PackJournal journal{archivePath, inputDir, options.pack};
+    auto        packOptions{options.pack};
+
+    packOptions.journal = &journal;
+
+    if (!Archiver::validateArchivePathForPack(archivePath))
+        return false;
+
+    // Files which did not change keep their data, only the changed ones are copied. An archive removed
+    // meanwhile is packed anew
+    if (!options.snapshot && QFileInfo::exists(archivePath))
+        return Archiver::append(archivePath, fileCollector, changedPaths, packOptions);
+
+    if (!journal.start())
+    {
+        qWarning() << "Cannot open the pack journal for: " << archivePath;
+        return false;
+    }
+
+    return Archiver::pack(archivePath, fileCollector, packOptions);
+}
+
+QString ArchiveWatcher::snapshotPath(const QString &outputDir)
+{
+    auto fileName{QDateTime::currentDateTime().toString(s_snapshotFormat) + s_snapshotSuffix};
+
+    return QDir{outputDir}.filePath(fileName);
+}
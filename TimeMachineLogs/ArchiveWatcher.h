@@ -0,0 +1,29 @@
+#ifndef ARCHIVEWATCHER_H
+#define ARCHIVEWATCHER_H
+
+#include <QSet>
+
+#include "ArchiverOptions.h"
+
+class FileCollector;
+
+class ArchiveWatcher
+{
+public:
+    // Packs the directory and keeps the archive up to date as files change, until it fails or is terminated.
+    // Updates either append to the archive or write a new snapshot archive into the output directory
+    static bool watch(const QString &inputDir, const QString &output, const WatchOptions &options);
+
+private:
+    static bool writeArchive(const QString &inputDir,
+                             const QString &output,
+                             const FileCollector &fileCollector,
+                             const QSet<QString> &changedPaths,
+                             const WatchOptions &options);
+    static QString snapshotPath(const QString &outputDir);
+
+    static constexpr auto s_snapshotFormat{"yyyyMMdd-HHmmss"};
+    static constexpr auto s_snapshotSuffix{".tml"};
+};
+
+#endif // ARCHIVEWATCHER_H
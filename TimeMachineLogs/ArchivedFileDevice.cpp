@@ -0,0 +1,86 @@
+#include <cstring>
+
+#include "ArchivedFileDevice.h"
+
+ArchivedFileDevice::ArchivedFileDevice(QIODevice &archiveDevice,
+                                       qint64 dataOffset,
+                                       qint64 size,
+                                       const QList<SparseFileCopier::Extent> &holes)
+    : m_archiveDevice{archiveDevice}
+    , m_dataOffset{dataOffset}
+    , m_size{size}
+    , m_holes{holes}
+{
+}
+
+bool ArchivedFileDevice::isSequential() const
+{
+    return false;
+}
+
+qint64 ArchivedFileDevice::size() const
+{
+    return m_size;
+}
+
+qint64 ArchivedFileDevice::readData(char *data, qint64 maxSize)
+{
+    auto   position{pos()};
+    qint64 bytesRead{0};
+
+    while (bytesRead < maxSize && position < m_size)
+    {
+        // Holes before the position are not stored, so they shift the position within the stored data
+        qint64 dataPosition{position};
+        auto   segmentEnd{m_size};
+        auto   inHole{false};
+
+        for (const auto &hole : m_holes)
+        {
+            if (hole.offset > position)
+            {
+                segmentEnd = hole.offset;
+                break;
+            }
+
+            if (position < hole.offset + hole.length)
+            {
+                segmentEnd = hole.offset + hole.length;
+                inHole = true;
+                break;
+            }
+
+            dataPosition -= hole.length;
+        }
+
+        auto toRead{qMin(maxSize - bytesRead, segmentEnd - position)};
+
+        if (inHole)
+        {
+            std::memset(data + bytesRead, 0, static_cast<size_t>(toRead));
+        }
+        else
+        {
+            if (!m_archiveDevice.seek(m_dataOffset + dataPosition))
+                return bytesRead > 0 ? bytesRead : -1;
+
+            toRead = m_archiveDevice.read(data + bytesRead, toRead);
+
+            if (toRead <= 0)
+                return bytesRead > 0 ? bytesRead : -1;
+        }
+
+        bytesRead += toRead;
+        position += toRead;
+    }
+
+    return bytesRead;
+}
+
+qint64 ArchivedFileDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(maxSize)
+
+    return -1;
+}
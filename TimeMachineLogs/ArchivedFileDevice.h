@@ -0,0 +1,32 @@
+#ifndef ARCHIVEDFILEDEVICE_H
+#define ARCHIVEDFILEDEVICE_H
+
+#include <QIODevice>
+
+#include "SparseFileCopier.h"
+
+// Read-only view of a single file inside an archive. Its data is read from the archive on demand and
+// its holes read as zeros, so the file is never held in memory as a whole
+class ArchivedFileDevice : public QIODevice
+{
+public:
+    ArchivedFileDevice(QIODevice &archiveDevice,
+                       qint64 dataOffset,
+                       qint64 size,
+                       const QList<SparseFileCopier::Extent> &holes);
+
+    bool   isSequential() const override;
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    QIODevice                      &m_archiveDevice;
+    qint64                          m_dataOffset;
+    qint64                          m_size;
+    QList<SparseFileCopier::Extent> m_holes;
+};
+
+#endif // ARCHIVEDFILEDEVICE_H
@@ -1,185 +1,1292 @@
+#include <QBuffer>
 #include <QDir>
 
+#include <memory>
+#include <optional>
+
+#include "ArchivedFileDevice.h"
 #include "Archiver.h"
+#include "BlobStore.h"
+#include "DiskSync.h"
+#include "FileHasher.h"
+#include "PackJournal.h"
+#include "TimestampScanner.h"
 
 bool Archiver::pack(const QString &archivePath,
                     const QList<FileEntry> &uniqueFiles,
                     const QList<QList<FileEntry> > &duplicateGroups,
                     qint64 chunkSize)
+{
+    PackOptions options;
+    qint64      totalBytes{0};
+
+    options.chunkSize = chunkSize;
+
+    for (const auto &file : uniqueFiles)
+        totalBytes += file.size();
+
+    for (const auto &group : duplicateGroups)
+    {
+        for (const auto &file : group)
+            totalBytes += file.size();
+    }
+
+    return packEntries(archivePath, [&](const FileCollector::EntryVisitor &visitor) {
+        for (const auto &file : uniqueFiles)
+        {
+            if (!visitor(file, true))
+                return false;
+        }
+
+        for (const auto &group : duplicateGroups)
+        {
+            for (qsizetype i{0}; i < group.size(); ++i)
+            {
+                if (!visitor(group.at(i), i == 0))
+                    return false;
+            }
+        }
+
+        return true;
+    }, totalBytes, options);
+}
+
+bool Archiver::pack(const QString &archivePath, const FileCollector &fileCollector, const PackOptions &options)
+{
+    return packEntries(archivePath, [&fileCollector](const FileCollector::EntryVisitor &visitor) {
+        return fileCollector.forEachEntry(visitor);
+    }, fileCollector.totalSize(), options);
+}
+
+bool Archiver::append(const QString &archivePath,
+                      const FileCollector &fileCollector,
+                      const QSet<QString> &changedPaths,
+                      const PackOptions &options)
+{
+    if (!options.journal)
+    {
+        qWarning() << "Appending to an archive needs a pack journal: " << archivePath;
+        return false;
+    }
+
+    if (!validateArchivePathForUnpack(archivePath))
+        return false;
+
+    QFile archiveFile{archivePath};
+
+    if (!archiveFile.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Cannot open archive: " << archivePath;
+        return false;
+    }
+
+    QDataStream     in{&archiveFile};
+    qint64          metadataOffset;
+    quint32         formatVersion;
+    QList<FileMeta> metadataList;
+
+    if (!readMetadataOffset(archiveFile, in, metadataOffset, formatVersion))
+        return false;
+
+    // New records replace the End record and the index - older layouts do not end their data right before them
+    if (formatVersion != s_formatVersion)
+    {
+        qWarning() << "Only archives of the current format version can be appended to: " << archivePath;
+        return false;
+    }
+
+    archiveFile.seek(metadataOffset);
+
+    if (!readMetadata(in, metadataList, formatVersion))
+        return false;
+
+    archiveFile.close();
+
+    QHash<QString, FileMeta> archivedFiles;
+
+    for (const auto &meta : std::as_const(metadataList))
+        archivedFiles.insert(meta.relativePath, meta);
+
+    // Files which did not change since keep the data they have in the archive
+    QList<QPair<FileEntry, FileMeta>> keptFiles;
+    QSet<qint64>                      liveOffsets;
+
+    fileCollector.forEachEntry([&](const FileEntry &file, bool) {
+        auto it{archivedFiles.constFind(file.relativePath())};
+
+        if (it == archivedFiles.constEnd())
+            return true;
+
+        if (it->size == file.size() && !changedPaths.contains(file.relativePath()))
+        {
+            keptFiles.append(qMakePair(file, it.value()));
+            liveOffsets.insert(it->dataOffset);
+        }
+
+        // The archived files left over are the ones removed since
+        archivedFiles.erase(it);
+
+        return true;
+    });
+
+    // Data of changed and removed files is dead - duplicates share their data, so each offset counts once
+    auto   countedOffsets{liveOffsets};
+    qint64 deadBytes{0};
+
+    for (const auto &meta : std::as_const(metadataList))
+    {
+        if (meta.dataOffset != s_storeOffset && !countedOffsets.contains(meta.dataOffset))
+        {
+            countedOffsets.insert(meta.dataOffset);
+            deadBytes += meta.dataSize();
+        }
+    }
+
+    // Files which keep changing, such as growing logs, would otherwise grow the archive with every update
+    if (deadBytes * 100 > metadataOffset * s_maxDeadDataPercent)
+        return compact(archivePath, fileCollector, options);
+
+    if (!options.journal->append(metadataOffset - s_endRecordSize, keptFiles, archivedFiles.keys()))
+        return false;
+
+    return pack(archivePath, fileCollector, options);
+}
+
+bool Archiver::compact(const QString &archivePath, const FileCollector &fileCollector, const PackOptions &options)
+{
+    // Packed next to the archive and renamed over it, so that a failure leaves the previous archive intact
+    auto compactPath{archivePath + s_compactSuffix};
+    auto compactOptions{options};
+
+    // Every file is read again, there is no earlier data to resume from
+    compactOptions.journal = nullptr;
+
+    qInfo() << "Rewriting archive without the data of changed and removed files: " << archivePath;
+
+    if (!pack(compactPath, fileCollector, compactOptions))
+    {
+        QFile::remove(compactPath);
+        return false;
+    }
+
+    // The rewritten archive has to be durable before it takes the previous one's place
+    QFile compactFile{compactPath};
+
+    if (!compactFile.open(QIODevice::ReadWrite) || !DiskSync::syncFile(compactFile))
+    {
+        qWarning() << "Cannot flush archive to disk: " << compactPath;
+        QFile::remove(compactPath);
+        return false;
+    }
+
+    compactFile.close();
+
+    if (!DiskSync::replaceFile(compactPath, archivePath))
+    {
+        QFile::remove(compactPath);
+        return false;
+    }
+
+    return DiskSync::syncDirectory(QFileInfo{archivePath}.absolutePath());
+}
+
+bool Archiver::pack(QIODevice &archiveDevice, const QList<Source> &sources, const PackOptions &options)
+{
+    // Index offsets are positions in the archive device, and data sizes are patched in after copying
+    if (!archiveDevice.isWritable() || archiveDevice.isSequential())
+    {
+        qWarning() << "Archive device has to be open for writing and random access.";
+        return false;
+    }
+
+    if (!options.storePath.isEmpty() || options.journal)
+    {
+        qWarning() << "Blob store and pack journal are only supported when packing a directory.";
+        return false;
+    }
+
+    QTemporaryFile metadataSpool;
+
+    if (!metadataSpool.open())
+    {
+        qWarning() << "Cannot create temporary metadata file for archive.";
+        return false;
+    }
+
+    // Only sources which share their size with another one can be duplicates and need hashing
+    QHash<qint64, qsizetype> sizeCounts;
+    qint64                   totalBytes{0};
+
+    for (const auto &source : sources)
+    {
+        ++sizeCounts[source.device->size()];
+        totalBytes += source.device->size();
+    }
+
+    QDataStream out{&archiveDevice};
+    QDataStream metadataOut{&metadataSpool};
+    qint64      metadataCount{0};
+    Progress    progress{options.progress, totalBytes};
+
+    QHash<QByteArray, FileMeta> storedContents;
+
+    out << s_streamMagic << s_formatVersion;
+
+    for (const auto &source : sources)
+    {
+        auto &device{*source.device};
+
+        FileMeta meta;
+
+        meta.relativePath = source.relativePath;
+        meta.size = device.size();
+
+        if (sizeCounts.value(meta.size) > 1)
+            meta.hash = FileHasher::calculateHash(device);
+
+        if (auto it{storedContents.constFind(meta.hash)}; !meta.hash.isEmpty() && it != storedContents.constEnd())
+        {
+            // Same contents were packed before - referenced instead of stored again
+            meta = it.value();
+            meta.relativePath = source.relativePath;
+
+            writeReferenceRecord(archiveDevice, meta, it->relativePath);
+        }
+        else
+        {
+            std::optional<TimestampScanner> timestampScanner;
+
+            if (options.indexTimestamps)
+                timestampScanner.emplace(QDate::currentDate().year(), TimestampScanner::YearOf::LastLine);
+
+            if (!writeDataRecord(archiveDevice,
+                                 device,
+                                 options.chunkSize,
+                                 timestampScanner ? &*timestampScanner : nullptr,
+                                 &progress,
+                                 meta))
+                return false;
+
+            setTimeRange(meta, timestampScanner ? &*timestampScanner : nullptr);
+
+            if (!meta.hash.isEmpty())
+                storedContents.insert(meta.hash, meta);
+        }
+
+        writeMetadataEntry(metadataOut, meta);
+        ++metadataCount;
+
+        if (metadataOut.status() != QDataStream::Ok || !progress.finishFile(meta.size))
+            return false;
+    }
+
+    return finishArchive(out, metadataSpool, metadataCount, options.chunkSize);
+}
+
+bool Archiver::packEntries(const QString &archivePath,
+                           const EntrySource &entrySource,
+                           qint64 totalBytes,
+                           const PackOptions &options)
 {
     // Validate archivePath for packing
     if (!validateArchivePathForPack(archivePath))
         return false;
 
-    QFile archiveFile{archivePath};
+    QFile archiveFile{archivePath};
+
+    // A resumed pack keeps the archive data up to the journal's last checkpoint and drops the rest
+    auto resumeOffset{options.journal ? options.journal->resumeOffset() : 0};
+    auto openMode{resumeOffset > 0 ? QIODevice::ReadWrite : QIODevice::WriteOnly};
+
+    if (!archiveFile.open(openMode))
+    {
+        qWarning() << "Cannot open archive file for writing: " << archivePath;
+        return false;
+    }
+
+    if (resumeOffset > 0 && (!archiveFile.resize(resumeOffset) || !archiveFile.seek(resumeOffset)))
+    {
+        qWarning() << "Cannot resume archive at offset" << resumeOffset << ":" << archivePath;
+        return false;
+    }
+
+    // Metadata entries are spooled to disk so the index never has to be held in memory
+    QTemporaryFile metadataSpool;
+
+    if (!metadataSpool.open())
+    {
+        qWarning() << "Cannot create temporary metadata file for archive: " << archivePath;
+        return false;
+    }
+
+    // In repository mode file contents go to the shared blob store instead of the archive
+    std::optional<BlobStore> blobStore;
+
+    if (!options.storePath.isEmpty())
+        blobStore.emplace(options.storePath);
+
+    QDataStream out{&archiveFile};
+    QDataStream metadataOut{&metadataSpool};
+    qint64      metadataCount{0};
+    Progress    progress{options.progress, totalBytes};
+
+    // The archive starts with a header, so that sequential readers can recognise its inline records
+    if (resumeOffset == 0)
+        out << s_streamMagic << s_formatVersion;
+
+    // Files removed since the archive was appended to are deleted by sequential readers before the new records
+    if (options.journal)
+    {
+        for (const auto &removedPath : options.journal->removedPaths())
+            writeRemovalRecord(archiveFile, removedPath);
+    }
+
+    // Write files content to the archive - duplicates only once, referencing their group's data
+    if (!writeEntries(archiveFile,
+                      entrySource,
+                      blobStore ? &*blobStore : nullptr,
+                      metadataOut,
+                      metadataCount,
+                      options,
+                      progress))
+        return false;
+
+    if (!finishArchive(out, metadataSpool, metadataCount, options.chunkSize))
+        return false;
+
+    archiveFile.close();
+
+    if (options.journal)
+        options.journal->finish();
+
+    return true;
+}
+
+bool Archiver::unpack(const QString &archivePath, const QString &outputDir, const UnpackOptions &options)
+{
+    // Validate archivePath for unpacking
+    if (!validateArchivePathForUnpack(archivePath))
+        return false;
+
+    // Validate outputDir for unpacking
+    if (!validateOutputDirForUnpack(outputDir))
+        return false;
+
+    QFile archiveFile{archivePath};
+
+    if (!archiveFile.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Cannot open archive: " << archivePath;
+        return false;
+    }
+
+    // Pipes cannot seek to the index - their files are restored in the order in which they arrive
+    if (archiveFile.isSequential())
+        return unpackStream(archiveFile, outputDir, options);
+
+    QList<FileMeta> metadataList;
+
+    // Get the metadata
+    if (!readIndex(archiveFile, metadataList) || !validateTimeWindow(metadataList, options))
+        return false;
+
+    // Archives packed in repository mode resolve file contents from the blob store
+    std::optional<BlobStore> blobStore;
+
+    if (!options.storePath.isEmpty())
+        blobStore.emplace(options.storePath);
+
+    qint64 totalBytes{0};
+
+    for (const auto &meta : std::as_const(metadataList))
+    {
+        if (overlapsTimeWindow(meta, options))
+            totalBytes += meta.size;
+    }
+
+    Progress progress{options.progress, totalBytes};
+
+    // Extract all files from the archive
+    for (qsizetype i{0}; i < metadataList.size(); ++i)
+    {
+        const auto &meta{metadataList.at(i)};
+
+        // Files without events in the requested time window are not even read
+        if (!overlapsTimeWindow(meta, options))
+            continue;
+
+        if (!extractFile(archiveFile, meta, outputDir, blobStore ? &*blobStore : nullptr, options.chunkSize, progress))
+            return false;
+
+        if (!progress.finishFile(meta.size))
+            return false;
+    }
+
+    return true;
+}
+
+bool Archiver::unpack(QIODevice &archiveDevice, const FileVisitor &visitor, const UnpackOptions &options)
+{
+    QList<FileMeta> metadataList;
+
+    if (!readIndex(archiveDevice, metadataList) || !validateTimeWindow(metadataList, options))
+        return false;
+
+    std::optional<BlobStore> blobStore;
+
+    if (!options.storePath.isEmpty())
+        blobStore.emplace(options.storePath);
+
+    qint64 totalBytes{0};
+
+    for (const auto &meta : std::as_const(metadataList))
+    {
+        if (overlapsTimeWindow(meta, options))
+            totalBytes += meta.size;
+    }
+
+    Progress progress{options.progress, totalBytes};
+
+    // Archives already in memory hand out their data in place instead of copying it
+    auto *archiveBuffer{qobject_cast<QBuffer *>(&archiveDevice)};
+
+    for (const auto &meta : std::as_const(metadataList))
+    {
+        if (!overlapsTimeWindow(meta, options))
+            continue;
+
+        std::unique_ptr<QIODevice> contents;
+
+        if (meta.dataOffset == s_storeOffset)
+        {
+            if (!blobStore)
+            {
+                qWarning() << "File contents are kept in a blob store, but no store was given: " << meta.relativePath;
+                return false;
+            }
+
+            contents = std::make_unique<QFile>(blobStore->blobPath(meta.hash));
+        }
+        else if (archiveBuffer && meta.holes.isEmpty())
+        {
+            // The view is not bounds checked on reads, so a corrupt index must not point outside the archive
+            if (meta.dataOffset < 0 || meta.size < 0 || meta.dataOffset > archiveBuffer->size() - meta.size)
+            {
+                qWarning() << "Archived contents lie outside of the archive for file: " << meta.relativePath;
+                return false;
+            }
+
+            auto buffer{std::make_unique<QBuffer>()};
+
+            buffer->setData(QByteArray::fromRawData(archiveBuffer->data().constData() + meta.dataOffset, meta.size));
+            contents = std::move(buffer);
+        }
+        else
+        {
+            contents = std::make_unique<ArchivedFileDevice>(archiveDevice, meta.dataOffset, meta.size, meta.holes);
+        }
+
+        if (!contents->open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        {
+            qWarning() << "Cannot read archived contents of file: " << meta.relativePath;
+            return false;
+        }
+
+        if (!visitor(meta, *contents))
+            return false;
+
+        if (!progress.finishFile(meta.size))
+            return false;
+    }
+
+    return true;
+}
+
+bool Archiver::unpackStream(QIODevice &archiveStream, const QString &outputDir, const UnpackOptions &options)
+{
+    if (!validateOutputDirForUnpack(outputDir))
+        return false;
+
+    // Event times are only known from the index, which arrives after all the files
+    if (options.fromTime || options.toTime)
+    {
+        qCritical() << "Time window extraction is not possible while reading an archive sequentially.";
+        return false;
+    }
+
+    QDataStream in{&archiveStream};
+    quint32     magic;
+    quint32     formatVersion;
+
+    in >> magic >> formatVersion;
+
+    if (in.status() != QDataStream::Ok || magic != s_streamMagic)
+    {
+        qCritical() << "Archive is not streamable - archives of older versions have to be unpacked from a file.";
+        return false;
+    }
+
+    if (formatVersion > s_formatVersion)
+    {
+        qCritical() << "Unsupported archive format version:" << formatVersion;
+        return false;
+    }
+
+    std::optional<BlobStore> blobStore;
+
+    if (!options.storePath.isEmpty())
+        blobStore.emplace(options.storePath);
+
+    // The total is unknown until the index at the end of the stream
+    Progress progress{options.progress, -1};
+
+    // Every record is read exactly once and in order, nothing is staged before it is restored
+    auto finished{false};
+
+    while (!finished)
+    {
+        if (!extractRecord(in, outputDir, blobStore ? &*blobStore : nullptr, options.chunkSize, progress, finished))
+            return false;
+    }
+
+    // Drain the index, so that the producer of the stream does not fail writing to a closed pipe
+    QByteArray buffer;
+
+    buffer.resize(static_cast<int>(options.chunkSize));
+
+    while (archiveStream.read(buffer.data(), buffer.size()) > 0)
+        continue;
+
+    return true;
+}
+
+Archiver::Progress::Progress(const ProgressCallback &callback, qint64 totalBytes)
+    : m_callback{callback}
+    , m_totalBytes{totalBytes}
+{
+}
+
+bool Archiver::Progress::update(qint64 fileBytes)
+{
+    return report(m_finishedBytes + fileBytes);
+}
+
+bool Archiver::Progress::finishFile(qint64 fileSize)
+{
+    m_finishedBytes += fileSize;
+
+    return report(m_finishedBytes);
+}
+
+bool Archiver::Progress::report(qint64 processedBytes) const
+{
+    if (!m_callback || m_callback(processedBytes, m_totalBytes))
+        return true;
+
+    qWarning() << "Operation cancelled.";
+    return false;
+}
+
+qint64 Archiver::FileMeta::dataSize() const
+{
+    auto dataSize{size};
+
+    for (const auto &hole : holes)
+        dataSize -= hole.length;
+
+    return dataSize;
+}
+
+bool Archiver::readIndex(const QString &archivePath, QList<FileMeta> &metadataList)
+{
+    if (!validateArchivePathForUnpack(archivePath))
+        return false;
+
+    QFile archiveFile{archivePath};
+
+    if (!archiveFile.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Cannot open archive: " << archivePath;
+        return false;
+    }
+
+    return readIndex(archiveFile, metadataList);
+}
+
+bool Archiver::writeContentToArchive(QIODevice &archiveDevice,
+                                     QIODevice &source,
+                                     qint64 chunkSize,
+                                     QList<SparseFileCopier::Extent> &holes,
+                                     TimestampScanner *timestampScanner,
+                                     Progress *progress)
+{
+    // Only the data between holes goes to the archive, the holes are recorded in the index instead
+    auto copied{SparseFileCopier::copy(source, chunkSize, [&](qint64 offset, const char *data, qint64 size) {
+        if (archiveDevice.write(data, size) != size)
+        {
+            qWarning() << "Failed writing to archive: " << archiveDevice.errorString();
+            return false;
+        }
+
+        // Timestamps are picked up from the very same buffer, the file is not read again
+        if (timestampScanner)
+            timestampScanner->feed(data, size);
+
+        return !progress || progress->update(offset + size);
+    }, holes)};
+
+    if (!copied)
+        return false;
+
+    if (timestampScanner)
+        timestampScanner->finish();
+
+    return true;
+}
+
+bool Archiver::scanFileTimestamps(const QString &sourceFilePath, TimestampScanner &timestampScanner, qint64 chunkSize)
+{
+    QFile src{sourceFilePath};
+
+    if (!src.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Cannot open file for reading: " << sourceFilePath;
+        return false;
+    }
+
+    QByteArray buffer;
+
+    buffer.resize(static_cast<int>(chunkSize));
+
+    qint64 bytesRead;
+
+    while ((bytesRead = src.read(buffer.data(), buffer.size())) > 0)
+        timestampScanner.feed(buffer.constData(), bytesRead);
+
+    timestampScanner.finish();
+
+    return true;
+}
+
+TimestampScanner Archiver::createTimestampScanner(const QString &sourceFilePath)
+{
+    // Syslog timestamps carry no year - it is counted on from the year in which the file was created. Where
+    // the filesystem does not record that, it is counted back from the year in which the file was last written
+    QFileInfo fileInfo{sourceFilePath};
+
+    if (auto created{fileInfo.birthTime()}; created.isValid())
+        return TimestampScanner{created.date().year(), TimestampScanner::YearOf::FirstLine};
+
+    return TimestampScanner{fileInfo.lastModified().date().year(), TimestampScanner::YearOf::LastLine};
+}
+
+bool Archiver::writeEntries(QFile &archiveFile,
+                            const EntrySource &entrySource,
+                            BlobStore *blobStore,
+                            QDataStream &metadataOut,
+                            qint64 &metadataCount,
+                            const PackOptions &options,
+                            Progress &progress)
+{
+    FileMeta groupMeta;
+
+    return entrySource([&](const FileEntry &file, bool isGroupLeader) {
+        // Only the first file of a group is the data source, its duplicates reference the same data
+        if (isGroupLeader && !writeGroupData(archiveFile, file, blobStore, options, progress, groupMeta))
+            return false;
+
+        auto meta{groupMeta};
+
+        meta.relativePath = file.relativePath();
+        meta.size = file.size();
+
+        // Files kept by an append or completed before an interruption have their records in the archive already
+        std::optional<FileMeta> completed;
+
+        if (options.journal)
+            completed = options.journal->completedFile(file);
+
+        if (completed && (completed->dataOffset == s_storeOffset) == (blobStore != nullptr))
+        {
+            meta = *completed;
+        }
+        else
+        {
+            // Data records were written along with the data, every other file refers to data elsewhere
+            if (meta.dataOffset == s_storeOffset || meta.relativePath != groupMeta.relativePath)
+                writeReferenceRecord(archiveFile, meta, groupMeta.relativePath);
+
+            // A checkpoint covers the file's data only once the file itself is recorded in front of it
+            if (options.journal)
+            {
+                options.journal->recordFile(file, meta);
+
+                if (!options.journal->dataWritten(archiveFile))
+                    return false;
+            }
+        }
+
+        writeMetadataEntry(metadataOut, meta);
+        ++metadataCount;
+
+        return metadataOut.status() == QDataStream::Ok && progress.finishFile(file.size());
+    });
+}
+
+bool Archiver::writeGroupData(QFile &archiveFile,
+                              const FileEntry &file,
+                              BlobStore *blobStore,
+                              const PackOptions &options,
+                              Progress &progress,
+                              FileMeta &groupMeta)
+{
+    auto *journal{options.journal};
+
+    groupMeta = FileMeta{};
+    groupMeta.relativePath = file.relativePath();
+    groupMeta.size = file.size();
+    groupMeta.hash = file.hash(); // Empty for files which did not need hashing
+
+    // Blobs are addressed by hash, so files which were unique by size need hashing too
+    if (blobStore && groupMeta.hash.isEmpty())
+    {
+        std::optional<QByteArray> cachedHash;
+
+        if (journal)
+            cachedHash = journal->cachedHash(file);
+
+        groupMeta.hash = cachedHash ? *cachedHash : FileHasher::calculateHash(file.path());
+
+        if (groupMeta.hash.isEmpty())
+        {
+            qWarning() << "Cannot calculate hash of file: " << file.path();
+            return false;
+        }
+
+        if (journal && !cachedHash)
+            journal->recordHash(file, groupMeta.hash);
+    }
+
+    // Data an interrupted run already wrote is reused, as long as the file did not change since
+    if (journal)
+    {
+        auto completed{journal->completedFile(file)};
+
+        if (!completed && !groupMeta.hash.isEmpty())
+            completed = journal->completedBlob(groupMeta.hash);
+
+        if (completed && (completed->dataOffset == s_storeOffset) == (blobStore != nullptr))
+        {
+            groupMeta = *completed;
+            return true;
+        }
+    }
+
+    std::optional<TimestampScanner> timestampScanner;
+
+    if (options.indexTimestamps)
+        timestampScanner.emplace(createTimestampScanner(file.path()));
+
+    if (blobStore)
+    {
+        groupMeta.dataOffset = s_storeOffset;
+
+        // Content already stored by another archive or an earlier run is not copied, but its timestamps
+        // have to be scanned separately
+        if (blobStore->contains(groupMeta.hash))
+        {
+            if (timestampScanner && !scanFileTimestamps(file.path(), *timestampScanner, options.chunkSize))
+                return false;
+        }
+        else
+        {
+            // New blobs are scanned and reported from the very same buffers they are stored from
+            auto stored{blobStore->put(groupMeta.hash,
+                                       file.path(),
+                                       options.chunkSize,
+                                       [&](qint64 offset, const char *data, qint64 size) {
+                                           if (timestampScanner)
+                                               timestampScanner->feed(data, size);
+
+                                           return progress.update(offset + size);
+                                       })};
+
+            if (!stored)
+                return false;
+
+            if (timestampScanner)
+                timestampScanner->finish();
+        }
+    }
+    else
+    {
+        QFile src{file.path()};
+
+        if (!src.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        {
+            qWarning() << "Cannot open file for reading: " << file.path();
+            return false;
+        }
+
+        if (!writeDataRecord(archiveFile,
+                             src,
+                             options.chunkSize,
+                             timestampScanner ? &*timestampScanner : nullptr,
+                             &progress,
+                             groupMeta))
+            return false;
+    }
+
+    setTimeRange(groupMeta, timestampScanner ? &*timestampScanner : nullptr);
+
+    return true;
+}
+
+bool Archiver::writeDataRecord(QIODevice &archiveDevice,
+                               QIODevice &source,
+                               qint64 chunkSize,
+                               TimestampScanner *timestampScanner,
+                               Progress *progress,
+                               FileMeta &meta)
+{
+    QDataStream out{&archiveDevice};
+
+    out << s_recordMagic << static_cast<quint8>(StreamRecord::Data);
+    out << meta.relativePath << meta.size;
+
+    // Holes and therefore the amount of data are only known once the file is copied - patched afterwards
+    auto dataSizePosition{archiveDevice.pos()};
+
+    out << qint64{0};
+
+    meta.dataOffset = archiveDevice.pos();
+
+    if (!writeContentToArchive(archiveDevice, source, chunkSize, meta.holes, timestampScanner, progress))
+        return false;
+
+    auto dataEnd{archiveDevice.pos()};
+
+    if (!archiveDevice.seek(dataSizePosition))
+    {
+        qWarning() << "Cannot seek in archive while writing file: " << meta.relativePath;
+        return false;
+    }
+
+    out << dataEnd - meta.dataOffset;
+
+    if (!archiveDevice.seek(dataEnd))
+    {
+        qWarning() << "Cannot seek in archive while writing file: " << meta.relativePath;
+        return false;
+    }
+
+    // The holes follow the data, sequential readers move the data into place once they know them
+    out << meta.holes;
+
+    return out.status() == QDataStream::Ok;
+}
+
+void Archiver::writeReferenceRecord(QIODevice &archiveDevice, const FileMeta &meta, const QString &dataSourcePath)
+{
+    QDataStream out{&archiveDevice};
+
+    if (meta.dataOffset == s_storeOffset)
+    {
+        out << s_recordMagic << static_cast<quint8>(StreamRecord::Stored);
+        out << meta.relativePath << meta.size << meta.hash;
+    }
+    else
+    {
+        out << s_recordMagic << static_cast<quint8>(StreamRecord::Duplicate);
+        out << meta.relativePath << meta.size << dataSourcePath;
+    }
+}
+
+void Archiver::writeRemovalRecord(QIODevice &archiveDevice, const QString &relativePath)
+{
+    QDataStream out{&archiveDevice};
+
+    out << s_recordMagic << static_cast<quint8>(StreamRecord::Removed);
+    out << relativePath;
+}
+
+void Archiver::setTimeRange(FileMeta &meta, const TimestampScanner *timestampScanner)
+{
+    if (timestampScanner && timestampScanner->hasRange())
+    {
+        meta.minTime = timestampScanner->minTime();
+        meta.maxTime = timestampScanner->maxTime();
+    }
+}
+
+void Archiver::writeMetadataEntry(QDataStream &out, const FileMeta &meta)
+{
+    out << meta;
+}
+
+bool Archiver::finishArchive(QDataStream &out, QTemporaryFile &metadataSpool, qint64 metadataCount, qint64 chunkSize)
+{
+    // Sequential readers stop here - the rest of the archive is there for random access only
+    out << s_recordMagic << static_cast<quint8>(StreamRecord::End);
+
+    // Write metadata index at the end of the file
+    qint64 metadataOffset;
+
+    if (!writeMetadata(out, metadataSpool, metadataCount, metadataOffset, chunkSize))
+        return false;
+
+    // Write metadata offset as footer so we can find it during unpack
+    writeMetadataOffset(out, metadataOffset);
+
+    return out.status() == QDataStream::Ok;
+}
 
-    if (!archiveFile.open(QIODevice::WriteOnly))
+bool Archiver::writeMetadata(QDataStream &out,
+                             QTemporaryFile &metadataSpool,
+                             qint64 metadataCount,
+                             qint64 &metadataOffset,
+                             qint64 chunkSize)
+{
+    metadataOffset = out.device()->pos();
+    out << metadataCount;
+
+    // Copy the spooled metadata entries behind the entry count
+    if (!metadataSpool.seek(0))
     {
-        qWarning() << "Cannot open archive file for writing: " << archivePath;
+        qWarning() << "Cannot rewind temporary metadata file.";
         return false;
     }
 
-    QDataStream out{&archiveFile};
+    QByteArray buffer;
 
-    QList<FileMeta> metadataList;
-    auto            totalFiles{uniqueFiles.size()};
+    buffer.resize(static_cast<int>(chunkSize));
 
-    for (const auto &group: duplicateGroups)
-        totalFiles += group.size();
+    qint64 bytesRead;
 
-    metadataList.reserve(totalFiles);
+    while ((bytesRead = metadataSpool.read(buffer.data(), buffer.size())) > 0)
+    {
+        if (out.writeRawData(buffer.constData(), static_cast<int>(bytesRead)) != bytesRead)
+        {
+            qWarning() << "Failed writing metadata to archive.";
+            return false;
+        }
+    }
 
-    // Write unique files to the archive
-    if (!writeUniqueFiles(archiveFile, uniqueFiles, metadataList, chunkSize))
-        return false;
+    return true;
+}
 
-    // Write duplicate files content once, record offsets by hash (calculated for duplicates)
-    if (!writeDuplicateFiles(archiveFile, duplicateGroups, metadataList, chunkSize))
+bool Archiver::readIndex(QIODevice &archiveDevice, QList<FileMeta> &metadataList)
+{
+    if (archiveDevice.isSequential())
+    {
+        qWarning() << "Archive index can only be read from a random access device.";
         return false;
+    }
 
-    // Write metadata index at the end of the file
-    qint64 metadataOffset;
+    QDataStream in{&archiveDevice};
 
-    if (!writeMetadata(out, metadataList, metadataOffset))
-        return false;
+    qint64  metadataOffset;
+    quint32 formatVersion;
 
-    // Write metadata offset as footer so we can find it during unpack
-    writeMetadataOffset(out, metadataOffset);
+    // Read medatada offset from the archive file's footer
+    if (!readMetadataOffset(archiveDevice, in, metadataOffset, formatVersion))
+        return false;
 
-    archiveFile.close();
+    archiveDevice.seek(metadataOffset);
 
-    return true;
+    return readMetadata(in, metadataList, formatVersion);
 }
 
-bool Archiver::unpack(const QString &archivePath, const QString &outputDir, qint64 chunkSize)
+bool Archiver::readMetadata(QDataStream &in, QList<FileMeta> &metadataList, quint32 formatVersion)
 {
-    // Validate archivePath for unpacking
-    if (!validateArchivePathForUnpack(archivePath))
-        return false;
-
-    // Validate outputDir for unpacking
-    if (!validateOutputDirForUnpack(outputDir))
-        return false;
+    qint64 fileCount;
 
-    QFile archiveFile{archivePath};
+    in >> fileCount;
 
-    if (!archiveFile.open(QIODevice::ReadOnly))
+    if (fileCount <= 0)
     {
-        qWarning() << "Cannot open archive: " << archivePath;
+        qWarning() << "No files stored in archive.";
         return false;
     }
 
-    QDataStream in{&archiveFile};
+    metadataList.reserve(static_cast<int>(fileCount));
 
-    qint64 metadataOffset;
+    for (qsizetype i{0}; i < fileCount; ++i)
+    {
+        FileMeta meta;
 
-    // Read medatada offset from the archive file's footer
-    if (!readMetadataOffset(archiveFile, in, metadataOffset))
-        return false;
+        in >> meta.relativePath;
+        in >> meta.size;
+        in >> meta.hash;
+        in >> meta.dataOffset;
 
-    archiveFile.seek(metadataOffset);
+        if (formatVersion >= s_timeRangeFormatVersion)
+        {
+            in >> meta.minTime;
+            in >> meta.maxTime;
+        }
 
-    QList<FileMeta> metadataList;
+        if (formatVersion >= s_sparseFormatVersion)
+            in >> meta.holes;
 
-    // Get the metadata
-    if (!readMetadata(in, metadataList))
-        return false;
+        metadataList.append(meta);
+    }
 
-    // Extract all files from the archive
-    for (qsizetype i{0}; i < metadataList.size(); ++i)
+    return true;
+}
+
+bool Archiver::extractFile(QFile &archiveFile,
+                           const FileMeta &meta,
+                           const QString &outputDir,
+                           const BlobStore *blobStore,
+                           qint64 chunkSize,
+                           Progress &progress)
+{
+    QFile blobFile;
+    auto  *dataSource{&archiveFile};
+
+    if (meta.dataOffset == s_storeOffset)
     {
-        const auto &meta{metadataList.at(i)};
+        if (!blobStore)
+        {
+            qWarning() << "Archive references a blob store, but none was provided for" << meta.relativePath;
+            return false;
+        }
+
+        blobFile.setFileName(blobStore->blobPath(meta.hash));
 
-        if (!extractFile(archiveFile, meta, outputDir, chunkSize))
+        if (!blobFile.open(QIODevice::ReadOnly))
+        {
+            qWarning() << "Missing blob in store for" << meta.relativePath;
             return false;
+        }
+
+        dataSource = &blobFile;
+    }
+    else
+    {
+        archiveFile.seek(meta.dataOffset);
     }
 
-    return true;
+    QFile outFile;
+
+    if (!openOutputFile(outFile, outputDir, meta.relativePath))
+        return false;
+
+    return writeFileData(*dataSource, outFile, meta.size, meta.holes, chunkSize, &progress);
 }
 
-bool Archiver::writeFileContentToArchive(QFile &archiveFile, const QString &sourceFilePath, qint64 chunkSize)
+bool Archiver::extractRecord(QDataStream &in,
+                             const QString &outputDir,
+                             const BlobStore *blobStore,
+                             qint64 chunkSize,
+                             Progress &progress,
+                             bool &finished)
 {
-    QFile src{sourceFilePath};
+    quint32 magic;
+    quint8  record;
 
-    if (!src.open(QIODevice::ReadOnly))
+    in >> magic >> record;
+
+    if (in.status() != QDataStream::Ok || magic != s_recordMagic)
     {
-        qWarning() << "Cannot open file for reading: " << sourceFilePath;
+        qWarning() << "Corrupted archive stream.";
         return false;
     }
 
-    QByteArray buffer;
+    if (record == static_cast<quint8>(StreamRecord::End))
+    {
+        finished = true;
+        return true;
+    }
 
-    buffer.resize(static_cast<int>(chunkSize));
+    QString relativePath;
 
-    qint64 bytesRead;
+    in >> relativePath;
 
-    while ((bytesRead = src.read(buffer.data(), buffer.size())) > 0)
+    if (record == static_cast<quint8>(StreamRecord::Removed))
     {
-        if (archiveFile.write(buffer.constData(), bytesRead) != bytesRead)
+        if (in.status() != QDataStream::Ok)
         {
-            qWarning() << "Failed writing to archive for file: " << sourceFilePath;
-            src.close();
+            qWarning() << "Corrupted archive stream.";
             return false;
         }
+
+        return removeRestoredFile(outputDir, relativePath);
     }
 
-    src.close();
+    qint64 size;
 
-    return true;
+    in >> size;
+
+    if (record == static_cast<quint8>(StreamRecord::Data))
+        return extractDataRecord(in, relativePath, size, outputDir, chunkSize, progress) && progress.finishFile(size);
+
+    // Duplicates are copied from the file restored before them, stored files from the blob store
+    QFile dataFile;
+
+    if (record == static_cast<quint8>(StreamRecord::Duplicate))
+    {
+        QString sourceRelativePath;
+
+        in >> sourceRelativePath;
+        QString sourcePath;
+
+        if (!resolveOutputPath(outputDir, sourceRelativePath, sourcePath))
+            return false;
+
+        dataFile.setFileName(sourcePath);
+    }
+    else if (record == static_cast<quint8>(StreamRecord::Stored))
+    {
+        QByteArray hash;
+
+        in >> hash;
+
+        if (!blobStore)
+        {
+            qWarning() << "Archive references a blob store, but none was provided for" << relativePath;
+            return false;
+        }
+
+        dataFile.setFileName(blobStore->blobPath(hash));
+    }
+    else
+    {
+        qWarning() << "Unknown record in archive stream:" << record;
+        return false;
+    }
+
+    if (in.status() != QDataStream::Ok)
+    {
+        qWarning() << "Corrupted archive stream.";
+        return false;
+    }
+
+    if (!dataFile.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Cannot open data of" << relativePath;
+        return false;
+    }
+
+    QFile outFile;
+
+    if (!openOutputFile(outFile, outputDir, relativePath))
+        return false;
+
+    return writeFileData(dataFile, outFile, size, {}, chunkSize, &progress) && progress.finishFile(size);
 }
 
-bool Archiver::writeMetadata(QDataStream &out, const QList<FileMeta> &metadataList, qint64 &metadataOffset)
+bool Archiver::removeRestoredFile(const QString &outputDir, const QString &relativePath)
 {
-    metadataOffset = out.device()->pos();
-    out << metadataList.size();
+    QString filePath;
 
-    for (const auto &meta : metadataList)
+    if (!resolveOutputPath(outputDir, relativePath, filePath))
+        return false;
+
+    if (QFile file{filePath}; file.exists() && !file.remove())
     {
-        out << meta.relativePath;
-        out << meta.size;
-        out << meta.hash;
-        out << meta.dataOffset;
+        qWarning() << "Cannot remove file: " << filePath;
+        return false;
     }
 
+    // Directories left empty go as well - a file of the same name may be restored in their place. The resolved
+    // path has no ".." components, so this stops at the output directory
+    QDir outputRoot{outputDir};
+
+    for (auto dirPath{QFileInfo{QDir::cleanPath(relativePath)}.path()}; dirPath != "." && outputRoot.rmdir(dirPath);)
+        dirPath = QFileInfo{dirPath}.path();
+
     return true;
 }
 
-bool Archiver::readMetadata(QDataStream &in, QList<FileMeta> &metadataList)
+bool Archiver::extractDataRecord(QDataStream &in,
+                                 const QString &relativePath,
+                                 qint64 size,
+                                 const QString &outputDir,
+                                 qint64 chunkSize,
+                                 Progress &progress)
 {
-    qint64 fileCount;
+    qint64 dataSize;
 
-    in >> fileCount;
+    in >> dataSize;
 
-    if (fileCount <= 0)
+    if (in.status() != QDataStream::Ok)
     {
-        qWarning() << "No files stored in archive.";
+        qWarning() << "Corrupted archive stream.";
         return false;
     }
 
-    metadataList.reserve(static_cast<int>(fileCount));
+    QFile outFile;
 
-    for (qsizetype i{0}; i < fileCount; ++i)
+    if (!openOutputFile(outFile, outputDir, relativePath))
+        return false;
+
+    // The holes follow the data - until they are known, the data is written compactly
+    if (!writeFileData(*in.device(), outFile, dataSize, {}, chunkSize, &progress))
+        return false;
+
+    QList<SparseFileCopier::Extent> holes;
+
+    in >> holes;
+
+    if (in.status() != QDataStream::Ok)
     {
-        FileMeta meta;
+        qWarning() << "Corrupted archive stream.";
+        return false;
+    }
 
-        in >> meta.relativePath;
-        in >> meta.size;
-        in >> meta.hash;
-        in >> meta.dataOffset;
+    return holes.isEmpty() || spreadOverHoles(outFile.fileName(), size, holes, chunkSize);
+}
 
-        metadataList.append(meta);
+bool Archiver::spreadOverHoles(const QString &filePath,
+                               qint64 size,
+                               const QList<SparseFileCopier::Extent> &holes,
+                               qint64 chunkSize)
+{
+    QFile compactFile{filePath};
+
+    if (!compactFile.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Cannot open file for reading: " << filePath;
+        return false;
+    }
+
+    // Laid out again next to the compact file, so that it can replace it by a rename
+    QTemporaryFile spreadFile{filePath + "-XXXXXX"};
+
+    if (!spreadFile.open())
+    {
+        qWarning() << "Cannot create temporary file next to: " << filePath;
+        return false;
     }
 
+    if (!writeFileData(compactFile, spreadFile, size, holes, chunkSize))
+        return false;
+
+    spreadFile.setPermissions(compactFile.permissions());
+    compactFile.close();
+    spreadFile.close();
+
+    // Replaced in one step, the file is never missing
+    if (!DiskSync::replaceFile(spreadFile.fileName(), filePath))
+        return false;
+
+    spreadFile.setAutoRemove(false);
+
     return true;
 }
 
-bool Archiver::extractFile(QFile &archiveFile, const FileMeta &meta, const QString &outputDir, qint64 chunkSize)
+bool Archiver::openOutputFile(QFile &outFile, const QString &outputDir, const QString &relativePath)
 {
-    auto outputFilePath{QDir{outputDir}.filePath(meta.relativePath)};
+    QString outputFilePath;
+
+    if (!resolveOutputPath(outputDir, relativePath, outputFilePath))
+        return false;
 
     QDir().mkpath(QFileInfo{outputFilePath}.path());
 
-    QFile outFile{outputFilePath};
+    outFile.setFileName(outputFilePath);
 
     if (!outFile.open(QIODevice::WriteOnly))
     {
@@ -187,34 +1294,83 @@ bool Archiver::extractFile(QFile &archiveFile, const FileMeta &meta, const QStri
         return false;
     }
 
-    archiveFile.seek(meta.dataOffset);
+    return true;
+}
+
+bool Archiver::resolveOutputPath(const QString &outputDir, const QString &relativePath, QString &outputPath)
+{
+    // Paths come from the archive - one which leads out of the output directory must not be written or removed
+    auto cleanPath{QDir::cleanPath(relativePath)};
+
+    if (cleanPath.isEmpty() || cleanPath == "." || cleanPath == ".." || cleanPath.startsWith("../")
+        || QDir::isAbsolutePath(cleanPath))
+    {
+        qWarning() << "Archive contains a path outside of the output directory: " << relativePath;
+        return false;
+    }
+
+    outputPath = QDir{outputDir}.filePath(cleanPath);
+
+    return true;
+}
 
+bool Archiver::writeFileData(QIODevice &dataSource,
+                             QFile &outFile,
+                             qint64 size,
+                             const QList<SparseFileCopier::Extent> &holes,
+                             qint64 chunkSize,
+                             Progress *progress)
+{
     QByteArray buffer;
 
     buffer.resize(static_cast<int>(chunkSize));
 
-    auto bytesRemaining{meta.size};
+    qint64    position{0};
+    qsizetype holeIndex{0};
 
-    while (bytesRemaining > 0)
+    while (position < size)
     {
-        auto toRead{qMin(bytesRemaining, chunkSize)};
-        auto bytesRead{archiveFile.read(buffer.data(), toRead)};
+        // Holes are not stored in the archive - seeking past them leaves them unallocated
+        if (holeIndex < holes.size() && holes.at(holeIndex).offset == position)
+        {
+            position += holes.at(holeIndex++).length;
+            continue;
+        }
+
+        auto dataEnd{holeIndex < holes.size() ? holes.at(holeIndex).offset : size};
+        auto toRead{qMin(dataEnd - position, chunkSize)};
+        auto bytesRead{dataSource.read(buffer.data(), toRead)};
 
         if (bytesRead <= 0)
         {
-            qWarning() << "Unexpected end of archive while reading" << meta.relativePath;
+            qWarning() << "Unexpected end of archive while reading" << outFile.fileName();
+            outFile.close();
+            return false;
+        }
+
+        // Zero blocks within the data, e.g. of blobs kept in the store, end up as holes as well
+        if (!SparseFileCopier::writeSparse(outFile, position, buffer.constData(), bytesRead))
+        {
+            qWarning() << "Failed writing file:" << outFile.fileName();
             outFile.close();
             return false;
         }
 
-        if (outFile.write(buffer.constData(), bytesRead) != bytesRead)
+        position += bytesRead;
+
+        if (progress && !progress->update(position))
         {
-            qWarning() << "Failed writing file:" << outputFilePath;
             outFile.close();
             return false;
         }
+    }
 
-        bytesRemaining -= bytesRead;
+    // Extends the file over trailing holes without allocating them
+    if (!outFile.resize(size))
+    {
+        qWarning() << "Failed writing file:" << outFile.fileName();
+        outFile.close();
+        return false;
     }
 
     outFile.close();
@@ -222,18 +1378,42 @@ bool Archiver::extractFile(QFile &archiveFile, const FileMeta &meta, const QStri
     return true;
 }
 
-bool Archiver::readMetadataOffset(QFile &archiveFile, QDataStream &in, qint64 &metadataOffset)
+bool Archiver::readMetadataOffset(QIODevice &archiveDevice,
+                                  QDataStream &in,
+                                  qint64 &metadataOffset,
+                                  quint32 &formatVersion)
 {
-    if (archiveFile.size() < static_cast<qint64>(sizeof(qint64)))
+    constexpr auto footerSize{static_cast<qint64>(sizeof(qint64) + 2 * sizeof(quint32))};
+
+    if (archiveDevice.size() < static_cast<qint64>(sizeof(qint64)))
+    {
+        qWarning() << "Archive too small to contain metadata offset.";
+        return false;
+    }
+
+    quint32 magic{0};
+
+    if (archiveDevice.size() >= footerSize)
     {
-        qWarning() << "Archive file too small to contain metadata offset.";
+        archiveDevice.seek(archiveDevice.size() - footerSize);
+        in >> metadataOffset >> formatVersion >> magic;
+    }
+
+    if (magic == s_formatMagic && formatVersion > s_formatVersion)
+    {
+        qWarning() << "Unsupported archive format version:" << formatVersion;
         return false;
     }
 
-    archiveFile.seek(archiveFile.size() - static_cast<qint64>(sizeof(qint64)));
-    in >> metadataOffset;
+    // Archives written before the format was versioned end with the metadata offset alone
+    if (magic != s_formatMagic || formatVersion <= s_legacyFormatVersion)
+    {
+        formatVersion = s_legacyFormatVersion;
+        archiveDevice.seek(archiveDevice.size() - static_cast<qint64>(sizeof(qint64)));
+        in >> metadataOffset;
+    }
 
-    if (metadataOffset < 0 || metadataOffset >= archiveFile.size())
+    if (metadataOffset < 0 || metadataOffset >= archiveDevice.size())
     {
         qWarning() << "Invalid metadata offset.";
         return false;
@@ -245,78 +1425,41 @@ bool Archiver::readMetadataOffset(QFile &archiveFile, QDataStream &in, qint64 &m
 void Archiver::writeMetadataOffset(QDataStream &out, qint64 offset)
 {
     out << offset;
+    out << s_formatVersion;
+    out << s_formatMagic;
 }
 
-bool Archiver::writeUniqueFiles(QFile &archiveFile,
-                                const QList<FileEntry> &uniqueFiles,
-                                QList<FileMeta> &metadataList,
-                                qint64 chunkSize)
+bool Archiver::validateTimeWindow(const QList<FileMeta> &metadataList, const UnpackOptions &options)
 {
-    for (const auto &file: uniqueFiles)
-    {
-        auto offset{archiveFile.pos()};
-
-        // Write unique file's content to the archive
-        if (!writeFileContentToArchive(archiveFile, file.path(), chunkSize))
-            return false;
-
-        // Store metadata for this file
-        FileMeta meta;
-
-        meta.relativePath = file.relativePath();
-        meta.size = file.size();
-        meta.hash = QByteArray{}; // No hash calculated for unique files
-        meta.dataOffset = offset;
+    if (!options.fromTime && !options.toTime)
+        return true;
 
-        metadataList.append(meta);
+    // Without any indexed time range every file would be skipped silently
+    for (const auto &meta : metadataList)
+    {
+        if (meta.hasTimeRange())
+            return true;
     }
 
-    return true;
+    qCritical() << "Archive has no time index - it has to be packed with time indexing for time window extraction.";
+
+    return false;
 }
 
-bool Archiver::writeDuplicateFiles(QFile &archiveFile,
-                                   const QList<QList<FileEntry>> &duplicateGroups,
-                                   QList<FileMeta> &metadataList,
-                                   qint64 chunkSize)
+bool Archiver::overlapsTimeWindow(const FileMeta &meta, const UnpackOptions &options)
 {
-    QHash<QByteArray, qint64> hashToOffset; // map file hash to offset in archive
-
-    for (const auto &group : duplicateGroups)
-    {
-        if (group.isEmpty())
-            continue;
-
-        const auto &dataSource{group.first()}; // First file in group is the data source
-        qint64     offset;
-
-        if (hashToOffset.contains(dataSource.hash()))
-        {
-            offset = hashToOffset.value(dataSource.hash());
-        }
-        else
-        {
-            offset = archiveFile.pos();
+    if (!options.fromTime && !options.toTime)
+        return true;
 
-            // Write data source file's content to the archive
-            if (!writeFileContentToArchive(archiveFile, dataSource.path(), chunkSize))
-                return false;
-
-            hashToOffset.insert(dataSource.hash(), offset);
-        }
-
-        // Store all duplicate files metadata for unpacking
-        for (const auto &duplicate : group)
-        {
-            FileMeta meta;
+    // Files without recognised timestamps cannot be placed in time
+    if (!meta.hasTimeRange())
+        return false;
 
-            meta.relativePath = duplicate.relativePath();
-            meta.size = duplicate.size();
-            meta.hash = duplicate.hash();
-            meta.dataOffset = offset;
+    if (options.fromTime && meta.maxTime < *options.fromTime)
+        return false;
 
-            metadataList.append(meta);
-        }
-    }
+    if (options.toTime && meta.minTime > *options.toTime)
+        return false;
 
     return true;
 }
@@ -356,7 +1499,8 @@ bool Archiver::validateArchivePathForUnpack(const QString &path)
         qCritical() << "Archive file does not exist:" << path;
         return false;
     }
-    if (!info.isFile())
+    // Pipes and other special files are accepted, they are unpacked as a stream
+    if (info.isDir())
     {
         qCritical() << "Archive path is not a file:" << path;
         return false;
@@ -384,3 +1528,29 @@ bool Archiver::validateOutputDirForUnpack(const QString &dirPath)
 
     return true;
 }
+
+QDataStream &operator<<(QDataStream &out, const Archiver::FileMeta &meta)
+{
+    out << meta.relativePath;
+    out << meta.size;
+    out << meta.hash;
+    out << meta.dataOffset;
+    out << meta.minTime;
+    out << meta.maxTime;
+    out << meta.holes;
+
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, Archiver::FileMeta &meta)
+{
+    in >> meta.relativePath;
+    in >> meta.size;
+    in >> meta.hash;
+    in >> meta.dataOffset;
+    in >> meta.minTime;
+    in >> meta.maxTime;
+    in >> meta.holes;
+
+    return in;
+}
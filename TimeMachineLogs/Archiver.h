@@ -1,7 +1,14 @@
 #ifndef ARCHIVER_H
 #define ARCHIVER_H
 
-#include "FileEntry.h"
+#include <QTemporaryFile>
+
+#include "ArchiverOptions.h"
+#include "FileCollector.h"
+#include "SparseFileCopier.h"
+
+class BlobStore;
+class TimestampScanner;
 
 class Archiver
 {
@@ -11,40 +18,209 @@ public:
                      const QList<QList<FileEntry>> &duplicateGroups,
                      qint64 chunkSize = s_chunkSize);
 
+    static bool pack(const QString &archivePath,
+                     const FileCollector &fileCollector,
+                     const PackOptions &options = {});
+
+    // Brings an archive packed from the same directory up to date: files which did not change keep their data,
+    // the changed ones are written behind it and the index is rewritten. Once most of the data belongs to files
+    // changed or removed since, the archive is rewritten instead. Needs a journal. The new records replace the
+    // previous index, so the archive cannot be unpacked until the append completes - an interrupted append is
+    // completed by resuming it like a pack, any other pack rewrites the archive
+    static bool append(const QString &archivePath,
+                       const FileCollector &fileCollector,
+                       const QSet<QString> &changedPaths,
+                       const PackOptions &options);
+
     static bool unpack(const QString &archivePath,
                        const QString &outputDir,
-                       qint64 chunkSize = s_chunkSize);
+                       const UnpackOptions &options = {});
+
+    // Restores the files strictly sequentially from their inline records, e.g. from a pipe or stdin
+    static bool unpackStream(QIODevice &archiveStream,
+                             const QString &outputDir,
+                             const UnpackOptions &options = {});
 
-private:
     struct FileMeta
     {
         QString    relativePath;
-        qint64     size;
+        qint64     size{0};
         QByteArray hash;
-        qint64     dataOffset;
+        qint64     dataOffset{0};
+        qint64     minTime{0};  // Range of event times found in the file's lines,
+        qint64     maxTime{-1}; // empty when no timestamps were indexed
+
+        QList<SparseFileCopier::Extent> holes; // Zero-filled regions left out of the stored data
+
+        bool   hasTimeRange() const { return minTime <= maxTime; }
+        qint64 dataSize() const;
     };
 
-    static bool writeFileContentToArchive(QFile &archiveFile, const QString &sourceFilePath, qint64 chunkSize);
-    static bool writeMetadata(QDataStream &out, const QList<FileMeta> &metadataList, qint64 &metadataOffset);
-    static bool readMetadata(QDataStream &in, QList<FileMeta> &metadataList);
-    static bool extractFile(QFile &archiveFile, const FileMeta &meta, const QString &outputDir, qint64 chunkSize);
-    static bool readMetadataOffset(QFile &archiveFile, QDataStream &in, qint64 &metadataOffset);
-    static void writeMetadataOffset(QDataStream &out, qint64 offset);
+    // In-memory source of a file to be packed - the device has to be open and random access. The filesystem
+    // is only asked for the holes of a QFile opened with QIODevice::Unbuffered, other devices are checked for
+    // zero blocks as they are read
+    struct Source
+    {
+        QString    relativePath;
+        QIODevice *device;
+    };
+
+    // Receives the unpacked files one by one. The contents device is only valid during the call - for
+    // archives held in a QBuffer it refers to the archive's data directly
+    using FileVisitor = std::function<bool(const FileMeta &meta, QIODevice &contents)>;
 
-    static bool writeUniqueFiles(QFile &archiveFile,
-                                 const QList<FileEntry> &uniqueFiles,
-                                 QList<FileMeta> &metadataList,
-                                 qint64 chunkSize);
-    static bool writeDuplicateFiles(QFile &archiveFile,
-                                    const QList<QList<FileEntry>> &duplicateGroups,
-                                    QList<FileMeta> &metadataList,
-                                    qint64 chunkSize);
+    // Counterparts of pack and unpack which do not touch the filesystem, e.g. for data already in memory.
+    // The archive device has to be random access, such as a QBuffer or a QFile
+    static bool pack(QIODevice &archiveDevice, const QList<Source> &sources, const PackOptions &options = {});
+    static bool unpack(QIODevice &archiveDevice, const FileVisitor &visitor, const UnpackOptions &options = {});
 
+    static bool readIndex(const QString &archivePath, QList<FileMeta> &metadataList);
+
+    // Checks the archive path and creates its directory, e.g. before a journal is kept next to the archive
     static bool validateArchivePathForPack(const QString &path);
+
+    static constexpr qint64 s_storeOffset{-1}; // Data offset of files kept in a blob store
+
+private:
+    // Reports processed bytes to the caller's callback, which may cancel the operation
+    class Progress
+    {
+    public:
+        Progress(const ProgressCallback &callback, qint64 totalBytes);
+
+        bool update(qint64 fileBytes);    // Bytes processed of the current file
+        bool finishFile(qint64 fileSize); // Moves on to the next file
+
+    private:
+        bool report(qint64 processedBytes) const;
+
+        const ProgressCallback &m_callback;
+        qint64                  m_totalBytes;
+        qint64                  m_finishedBytes{0};
+    };
+
+    // Inline records in front of the data, so that the archive can be unpacked without seeking
+    enum class StreamRecord : quint8
+    {
+        Data,      // File contents follow, its holes behind them
+        Duplicate, // Same contents as a file restored before
+        Stored,    // Contents are kept in the blob store
+        End,       // No more files - the index follows
+        Removed    // File restored before was removed by an append
+    };
+
+    // Feeds every file to be archived into the given visitor, see FileCollector::forEachEntry()
+    using EntrySource = std::function<bool(const FileCollector::EntryVisitor &visitor)>;
+
+    static bool packEntries(const QString &archivePath,
+                            const EntrySource &entrySource,
+                            qint64 totalBytes,
+                            const PackOptions &options);
+    static bool compact(const QString &archivePath, const FileCollector &fileCollector, const PackOptions &options);
+    static bool writeContentToArchive(QIODevice &archiveDevice,
+                                      QIODevice &source,
+                                      qint64 chunkSize,
+                                      QList<SparseFileCopier::Extent> &holes,
+                                      TimestampScanner *timestampScanner,
+                                      Progress *progress);
+    static bool writeGroupData(QFile &archiveFile,
+                               const FileEntry &file,
+                               BlobStore *blobStore,
+                               const PackOptions &options,
+                               Progress &progress,
+                               FileMeta &groupMeta);
+    static bool writeDataRecord(QIODevice &archiveDevice,
+                                QIODevice &source,
+                                qint64 chunkSize,
+                                TimestampScanner *timestampScanner,
+                                Progress *progress,
+                                FileMeta &meta);
+    static void writeReferenceRecord(QIODevice &archiveDevice, const FileMeta &meta, const QString &dataSourcePath);
+    static void writeRemovalRecord(QIODevice &archiveDevice, const QString &relativePath);
+    static bool scanFileTimestamps(const QString &sourceFilePath, TimestampScanner &timestampScanner, qint64 chunkSize);
+    static TimestampScanner createTimestampScanner(const QString &sourceFilePath);
+    static void setTimeRange(FileMeta &meta, const TimestampScanner *timestampScanner);
+    static bool writeEntries(QFile &archiveFile,
+                             const EntrySource &entrySource,
+                             BlobStore *blobStore,
+                             QDataStream &metadataOut,
+                             qint64 &metadataCount,
+                             const PackOptions &options,
+                             Progress &progress);
+    static void writeMetadataEntry(QDataStream &out, const FileMeta &meta);
+    static bool finishArchive(QDataStream &out, QTemporaryFile &metadataSpool, qint64 metadataCount, qint64 chunkSize);
+    static bool writeMetadata(QDataStream &out,
+                              QTemporaryFile &metadataSpool,
+                              qint64 metadataCount,
+                              qint64 &metadataOffset,
+                              qint64 chunkSize);
+    static bool readIndex(QIODevice &archiveDevice, QList<FileMeta> &metadataList);
+    static bool readMetadata(QDataStream &in, QList<FileMeta> &metadataList, quint32 formatVersion);
+    static bool extractFile(QFile &archiveFile,
+                            const FileMeta &meta,
+                            const QString &outputDir,
+                            const BlobStore *blobStore,
+                            qint64 chunkSize,
+                            Progress &progress);
+    static bool extractRecord(QDataStream &in,
+                              const QString &outputDir,
+                              const BlobStore *blobStore,
+                              qint64 chunkSize,
+                              Progress &progress,
+                              bool &finished);
+    static bool removeRestoredFile(const QString &outputDir, const QString &relativePath);
+    static bool extractDataRecord(QDataStream &in,
+                                  const QString &relativePath,
+                                  qint64 size,
+                                  const QString &outputDir,
+                                  qint64 chunkSize,
+                                  Progress &progress);
+    static bool spreadOverHoles(const QString &filePath,
+                                qint64 size,
+                                const QList<SparseFileCopier::Extent> &holes,
+                                qint64 chunkSize);
+    static bool openOutputFile(QFile &outFile, const QString &outputDir, const QString &relativePath);
+    static bool resolveOutputPath(const QString &outputDir, const QString &relativePath, QString &outputPath);
+    static bool writeFileData(QIODevice &dataSource,
+                              QFile &outFile,
+                              qint64 size,
+                              const QList<SparseFileCopier::Extent> &holes,
+                              qint64 chunkSize,
+                              Progress *progress = nullptr);
+    static bool readMetadataOffset(QIODevice &archiveDevice,
+                                   QDataStream &in,
+                                   qint64 &metadataOffset,
+                                   quint32 &formatVersion);
+    static void writeMetadataOffset(QDataStream &out, qint64 offset);
+
     static bool validateArchivePathForUnpack(const QString &path);
     static bool validateOutputDirForUnpack(const QString &dirPath);
 
-    static constexpr qint64 s_chunkSize{4 * 1024 * 1024};
+    static bool validateTimeWindow(const QList<FileMeta> &metadataList, const UnpackOptions &options);
+    static bool overlapsTimeWindow(const FileMeta &meta, const UnpackOptions &options);
+
+    static constexpr qint64 s_chunkSize{PackOptions::s_chunkSize};
+
+    // Footer of versioned archives: metadata offset, format version and magic. Archives written before
+    // the format was versioned end with the metadata offset alone
+    static constexpr quint32 s_formatMagic{0x544D4C46}; // "TMLF"
+    static constexpr quint32 s_legacyFormatVersion{1};
+    static constexpr quint32 s_timeRangeFormatVersion{2}; // Adds the event time range of every file
+    static constexpr quint32 s_sparseFormatVersion{3};    // Adds the holes left out of every file's data
+    static constexpr quint32 s_streamFormatVersion{4};    // Adds a header and inline records for sequential reading
+    static constexpr quint32 s_removalFormatVersion{5};   // Adds records of files removed by an append
+    static constexpr quint32 s_formatVersion{s_removalFormatVersion};
+
+    static constexpr quint32 s_streamMagic{0x544D4C53}; // "TMLS"
+    static constexpr quint32 s_recordMagic{0x544D4C52}; // "TMLR"
+    static constexpr qint64  s_endRecordSize{sizeof(quint32) + sizeof(quint8)};
+
+    static constexpr auto   s_compactSuffix{".compact"};
+    static constexpr qint64 s_maxDeadDataPercent{50}; // Of an archive's data, before appending rewrites it instead
 };
 
+// Serialises index entries in the current format, see Archiver::readMetadata() for older ones
+QDataStream &operator<<(QDataStream &out, const Archiver::FileMeta &meta);
+QDataStream &operator>>(QDataStream &in, Archiver::FileMeta &meta);
+
 #endif // ARCHIVER_H
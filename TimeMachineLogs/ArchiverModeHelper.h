@@ -13,6 +13,8 @@ public:
     {
         Pack,
         Unpack,
+        Search,
+        Watch,
         Unknown
     };
     Q_ENUM(Mode)
@@ -0,0 +1,56 @@
+#ifndef ARCHIVEROPTIONS_H
+#define ARCHIVEROPTIONS_H
+
+#include <QString>
+
+#include <functional>
+#include <optional>
+
+#include "IoScheduler.h"
+
+class PackJournal;
+
+// Called as an operation advances, returning false cancels it. The total is -1 when it is not known
+// in advance, e.g. while unpacking a stream
+using ProgressCallback = std::function<bool(qint64 processedBytes, qint64 totalBytes)>;
+
+struct PackOptions
+{
+    QString          storePath;              // Blob store for file contents - the archive keeps only the index when set
+    bool             indexTimestamps{false}; // Record the range of log event times of every file
+    PackJournal     *journal{nullptr};       // Records progress so that an interrupted pack can be resumed
+    ProgressCallback progress;
+    qint64           chunkSize{s_chunkSize};
+
+    static constexpr qint64 s_chunkSize{4 * 1024 * 1024};
+};
+
+struct UnpackOptions
+{
+    QString               storePath; // Blob store referenced by archives packed in repository mode
+    std::optional<qint64> fromTime;  // Extract only files with events inside this time window,
+    std::optional<qint64> toTime;    // in milliseconds since epoch, see TimestampScanner
+    ProgressCallback      progress;
+    qint64                chunkSize{PackOptions::s_chunkSize};
+};
+
+struct SearchOptions
+{
+    QString storePath;                 // Blob store referenced by archives packed in repository mode
+    bool    regularExpression{false}; // Treat the pattern as a regular expression instead of a literal
+    int     threadCount{0};           // Number of worker threads, 0 uses one per CPU core
+    qint64  chunkSize{PackOptions::s_chunkSize};
+};
+
+struct WatchOptions
+{
+    PackOptions            pack;                 // Applied to every archive update, the watcher provides the journal
+    qint64                 interval{s_interval}; // Milliseconds between archive updates
+    bool                   snapshot{false};      // Write a new archive on every update instead of appending to one
+    bool                   resume{false};        // Continue an interrupted pack or append from its journal first
+    IoScheduler::ReadOrder readOrder{IoScheduler::ReadOrder::Physical};
+
+    static constexpr qint64 s_interval{5 * 60 * 1000};
+};
+
+#endif // ARCHIVEROPTIONS_H
@@ -0,0 +1,122 @@
+#include <QDebug>
+#include <QDir>
+#include <QTemporaryFile>
+
+#include "BlobStore.h"
+#include "DiskSync.h"
+#include "FileHasher.h"
+
+BlobStore::BlobStore(const QString &storePath)
+    : m_objectsPath{QDir{storePath}.filePath(s_objectsDir)}
+    , m_stagingPath{QDir{storePath}.filePath(s_stagingDir)}
+{
+    if (!QDir().mkpath(m_objectsPath) || !QDir().mkpath(m_stagingPath))
+        throw std::runtime_error(QString("Invalid blob store directory: %1").arg(storePath).toStdString());
+}
+
+bool BlobStore::contains(const QByteArray &hash) const
+{
+    return QFileInfo::exists(blobPath(hash));
+}
+
+bool BlobStore::put(const QByteArray &hash,
+                    const QString &sourceFilePath,
+                    qint64 chunkSize,
+                    const SparseFileCopier::DataWriter &observer)
+{
+    auto targetPath{blobPath(hash)};
+
+    if (!QDir().mkpath(QFileInfo{targetPath}.path()))
+    {
+        qWarning() << "Cannot create blob store directory for: " << targetPath;
+        return false;
+    }
+
+    QFile src{sourceFilePath};
+
+    if (!src.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+    {
+        qWarning() << "Cannot open file for reading: " << sourceFilePath;
+        return false;
+    }
+
+    // Stage the blob next to the objects so that committing it is a single atomic rename
+    QTemporaryFile staged{QDir{m_stagingPath}.filePath("blob-XXXXXX")};
+
+    if (!staged.open())
+    {
+        qWarning() << "Cannot create staging file in blob store: " << m_stagingPath;
+        return false;
+    }
+
+    // Blobs keep the full contents, but holes and zero blocks are only seeked over so they stay unallocated
+    QList<SparseFileCopier::Extent> holes;
+
+    // The hash was calculated before the copy - the staged data is hashed again, with zeros for the holes
+    QCryptographicHash hasher{FileHasher::s_algorithm};
+    qint64             hashedBytes{0};
+    auto               sourceSize{src.size()};
+
+    auto copied{SparseFileCopier::copy(src, chunkSize, [&](qint64 offset, const char *data, qint64 size) {
+        if (!staged.seek(offset) || staged.write(data, size) != size)
+            return false;
+
+        addZeros(hasher, offset - hashedBytes);
+        hasher.addData(QByteArrayView{data, size});
+        hashedBytes = offset + size;
+
+        return !observer || observer(offset, data, size);
+    }, holes)};
+
+    if (!copied || !staged.resize(sourceSize))
+    {
+        qWarning() << "Failed writing to blob store for file: " << sourceFilePath;
+        return false;
+    }
+
+    addZeros(hasher, sourceSize - hashedBytes);
+
+    // Publishing other contents under the hash would hand them to every archive referencing it from now on
+    if (hasher.result() != hash)
+    {
+        qWarning() << "File changed after it was hashed, not storing it: " << sourceFilePath;
+        return false;
+    }
+
+    // Blobs are shared by every user of the store and never modified once committed
+    staged.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ReadGroup
+                          | QFileDevice::ReadOther);
+
+    // The data has to be durable before the rename publishes it - other archives trust any blob present
+    if (!DiskSync::syncFile(staged))
+    {
+        qWarning() << "Cannot flush blob to disk: " << targetPath;
+        return false;
+    }
+
+    if (staged.rename(targetPath))
+        return DiskSync::syncDirectory(QFileInfo{targetPath}.path());
+
+    // Another writer committed the same content in the meantime - its blob is just as good
+    if (QFileInfo::exists(targetPath))
+        return true;
+
+    qWarning() << "Cannot commit blob to store: " << targetPath;
+
+    return false;
+}
+
+void BlobStore::addZeros(QCryptographicHash &hasher, qint64 length)
+{
+    static const QByteArray zeros(SparseFileCopier::s_blockSize, '\0');
+
+    for (; length > 0; length -= zeros.size())
+        hasher.addData(QByteArrayView{zeros}.first(qMin(length, qint64{zeros.size()})));
+}
+
+QString BlobStore::blobPath(const QByteArray &hash) const
+{
+    auto hexHash{QString::fromLatin1(hash.toHex())};
+
+    return QDir{m_objectsPath}.filePath(hexHash.left(s_fanOutLength) + QDir::separator() + hexHash.mid(s_fanOutLength));
+}
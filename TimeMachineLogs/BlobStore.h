@@ -0,0 +1,35 @@
+#ifndef BLOBSTORE_H
+#define BLOBSTORE_H
+
+#include <QCryptographicHash>
+
+#include "SparseFileCopier.h"
+
+// Content-addressed directory of file contents shared by many archives. Blobs are named after
+// their hash and committed with an atomic rename, so concurrent writers never expose partial blobs
+class BlobStore
+{
+public:
+    explicit BlobStore(const QString &storePath);
+
+    bool    contains(const QByteArray &hash) const;
+    // The observer sees the stored data as it is copied, so that it does not have to be read again. Fails when
+    // the file's contents do not match the hash anymore, e.g. because it was written to since it was hashed
+    bool    put(const QByteArray &hash,
+                const QString &sourceFilePath,
+                qint64 chunkSize,
+                const SparseFileCopier::DataWriter &observer = {});
+    QString blobPath(const QByteArray &hash) const;
+
+private:
+    static void addZeros(QCryptographicHash &hasher, qint64 length);
+
+    QString m_objectsPath;
+    QString m_stagingPath;
+
+    static constexpr auto      s_objectsDir{"objects"};
+    static constexpr auto      s_stagingDir{"staging"};
+    static constexpr qsizetype s_fanOutLength{2};
+};
+
+#endif // BLOBSTORE_H
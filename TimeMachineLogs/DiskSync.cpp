@@ -0,0 +1,70 @@
+#include <QDebug>
+#include <QDir>
+
+#include "DiskSync.h"
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool DiskSync::syncFile(QFile &file)
+{
+    if (!file.flush())
+        return false;
+
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+bool DiskSync::syncDirectory(const QString &dirPath)
+{
+#ifdef Q_OS_WIN
+    // Renames are journaled by NTFS, directories cannot be flushed separately
+    Q_UNUSED(dirPath)
+
+    return true;
+#else
+    auto directory{::open(QFile::encodeName(dirPath).constData(), O_RDONLY | O_DIRECTORY)};
+
+    if (directory < 0)
+    {
+        qWarning() << "Cannot open directory: " << dirPath;
+        return false;
+    }
+
+    auto synced{::fsync(directory) == 0};
+
+    ::close(directory);
+
+    if (!synced)
+        qWarning() << "Cannot flush directory to disk: " << dirPath;
+
+    return synced;
+#endif
+}
+
+bool DiskSync::replaceFile(const QString &filePath, const QString &targetPath)
+{
+    // QFile::rename() refuses existing targets, removing them first would leave a moment without either file
+#ifdef Q_OS_WIN
+    auto replaced{::MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(filePath).utf16()),
+                                reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(targetPath).utf16()),
+                                MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)
+                  != 0};
+#else
+    auto replaced{::rename(QFile::encodeName(filePath).constData(), QFile::encodeName(targetPath).constData()) == 0};
+#endif
+
+    if (!replaced)
+        qWarning() << "Cannot replace file: " << targetPath;
+
+    return replaced;
+}
@@ -0,0 +1,19 @@
+#ifndef DISKSYNC_H
+#define DISKSYNC_H
+
+#include <QFile>
+
+// Makes file contents and directory entries durable, so that what a journal or an index refers to
+// survives a crash or power loss
+class DiskSync
+{
+public:
+    static bool syncFile(QFile &file);
+    static bool syncDirectory(const QString &dirPath);
+
+    // Renames the file over the target in a single step - the target is either the old or the new file,
+    // it never goes missing. Only durable once the target's directory is synced
+    static bool replaceFile(const QString &filePath, const QString &targetPath);
+};
+
+#endif // DISKSYNC_H
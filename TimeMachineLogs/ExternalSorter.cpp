@@ -0,0 +1,205 @@
+#include <QDebug>
+#include <QFile>
+
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+
+#include "ExternalSorter.h"
+
+ExternalSorter::ExternalSorter(qint64 memoryBudget, LessThan lessThan)
+    : m_memoryBudget{memoryBudget}
+    , m_lessThan{std::move(lessThan)}
+{
+    if (!m_spillDir.isValid())
+        throw std::runtime_error(QString("Cannot create spill directory: %1").arg(m_spillDir.errorString()).toStdString());
+}
+
+void ExternalSorter::add(FileEntry entry)
+{
+    m_bufferFootprint += estimateFootprint(entry);
+    m_buffer.append(std::move(entry));
+
+    // Buffer reached the budget - sort it and move it out of memory as a new run
+    if (m_bufferFootprint >= m_memoryBudget)
+        spill();
+}
+
+void ExternalSorter::finish()
+{
+    // Everything fitted in memory - no need to touch the disk at all
+    if (m_runPaths.isEmpty())
+    {
+        std::sort(m_buffer.begin(), m_buffer.end(), m_lessThan);
+        return;
+    }
+
+    spill();
+    reduceRuns();
+}
+
+bool ExternalSorter::forEachSorted(const Visitor &visitor) const
+{
+    if (m_runPaths.isEmpty())
+    {
+        for (const auto &entry : m_buffer)
+        {
+            if (!visitor(entry))
+                return false;
+        }
+
+        return true;
+    }
+
+    return mergeRuns(m_runPaths, visitor);
+}
+
+void ExternalSorter::spill()
+{
+    if (m_buffer.isEmpty())
+        return;
+
+    std::sort(m_buffer.begin(), m_buffer.end(), m_lessThan);
+
+    auto  runPath{nextRunPath()};
+    QFile runFile{runPath};
+
+    if (!runFile.open(QIODevice::WriteOnly))
+        throw std::runtime_error(QString("Cannot create sort run file: %1").arg(runPath).toStdString());
+
+    QDataStream out{&runFile};
+
+    for (const auto &entry : std::as_const(m_buffer))
+        out << entry;
+
+    if (out.status() != QDataStream::Ok)
+        throw std::runtime_error(QString("Failed writing sort run file: %1").arg(runPath).toStdString());
+
+    runFile.close();
+
+    m_runPaths.append(runPath);
+    m_buffer.clear();
+    m_bufferFootprint = 0;
+}
+
+void ExternalSorter::reduceRuns()
+{
+    // Merge the oldest runs together until all of them can be opened at once
+    while (m_runPaths.size() > s_maxMergeFanIn)
+    {
+        auto batch{m_runPaths.mid(0, s_maxMergeFanIn)};
+
+        m_runPaths.remove(0, s_maxMergeFanIn);
+
+        auto  mergedPath{nextRunPath()};
+        QFile mergedFile{mergedPath};
+
+        if (!mergedFile.open(QIODevice::WriteOnly))
+            throw std::runtime_error(QString("Cannot create sort run file: %1").arg(mergedPath).toStdString());
+
+        QDataStream out{&mergedFile};
+
+        auto merged{mergeRuns(batch, [&out](const FileEntry &entry) {
+            out << entry;
+            return out.status() == QDataStream::Ok;
+        })};
+
+        if (!merged)
+            throw std::runtime_error(QString("Failed merging sort runs into: %1").arg(mergedPath).toStdString());
+
+        mergedFile.close();
+
+        for (const auto &runPath : batch)
+            QFile::remove(runPath);
+
+        m_runPaths.append(mergedPath);
+    }
+}
+
+bool ExternalSorter::mergeRuns(const QStringList &runPaths, const Visitor &visitor) const
+{
+    struct RunReader
+    {
+        QFile       file;
+        QDataStream stream;
+        FileEntry   head;
+    };
+
+    std::vector<std::unique_ptr<RunReader>> readers;
+
+    readers.reserve(runPaths.size());
+
+    for (const auto &runPath : runPaths)
+    {
+        auto reader{std::make_unique<RunReader>()};
+
+        reader->file.setFileName(runPath);
+
+        if (!reader->file.open(QIODevice::ReadOnly))
+        {
+            qWarning() << "Cannot open sort run file:" << runPath;
+            return false;
+        }
+
+        reader->stream.setDevice(&reader->file);
+
+        if (reader->stream.atEnd())
+            continue;
+
+        reader->stream >> reader->head;
+        readers.push_back(std::move(reader));
+    }
+
+    // Min-heap over the current head entry of every run
+    auto greater{[this, &readers](std::size_t left, std::size_t right) {
+        return m_lessThan(readers[right]->head, readers[left]->head);
+    }};
+
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> heap{greater};
+
+    for (std::size_t i{0}; i < readers.size(); ++i)
+        heap.push(i);
+
+    while (!heap.empty())
+    {
+        auto index{heap.top()};
+        auto &reader{*readers[index]};
+
+        heap.pop();
+
+        if (!visitor(reader.head))
+            return false;
+
+        if (reader.stream.atEnd())
+            continue;
+
+        reader.stream >> reader.head;
+
+        if (reader.stream.status() != QDataStream::Ok)
+        {
+            qWarning() << "Corrupted sort run file:" << reader.file.fileName();
+            return false;
+        }
+
+        heap.push(index);
+    }
+
+    return true;
+}
+
+QString ExternalSorter::nextRunPath()
+{
+    return m_spillDir.filePath(QString("run-%1").arg(m_runCounter++));
+}
+
+qint64 ExternalSorter::estimateFootprint(const FileEntry &entry)
+{
+    auto characters{entry.name().size() + entry.path().size() + entry.relativePath().size()};
+
+    return static_cast<qint64>(sizeof(FileEntry))
+           + characters * static_cast<qint64>(sizeof(QChar))
+           + entry.hash().size()
+           + s_allocationOverhead;
+}
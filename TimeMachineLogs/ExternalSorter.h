@@ -0,0 +1,45 @@
+#ifndef EXTERNALSORTER_H
+#define EXTERNALSORTER_H
+
+#include <QTemporaryDir>
+
+#include <functional>
+
+#include "FileEntry.h"
+
+// Sorts file entries within a fixed memory budget - entries exceeding the budget are spilled
+// to sorted run files on disk and merged back together when iterated
+class ExternalSorter
+{
+public:
+    using LessThan = std::function<bool(const FileEntry &, const FileEntry &)>;
+    using Visitor  = std::function<bool(const FileEntry &)>;
+
+    explicit ExternalSorter(qint64 memoryBudget, LessThan lessThan);
+
+    void add(FileEntry entry);
+    void finish();
+
+    bool forEachSorted(const Visitor &visitor) const;
+
+private:
+    void spill();
+    void reduceRuns();
+    bool mergeRuns(const QStringList &runPaths, const Visitor &visitor) const;
+    QString nextRunPath();
+
+    static qint64 estimateFootprint(const FileEntry &entry);
+
+    qint64           m_memoryBudget;
+    LessThan         m_lessThan;
+    QTemporaryDir    m_spillDir;
+    QList<FileEntry> m_buffer;
+    qint64           m_bufferFootprint{0};
+    QStringList      m_runPaths;
+    int              m_runCounter{0};
+
+    static constexpr qsizetype s_maxMergeFanIn{64};
+    static constexpr qint64    s_allocationOverhead{64};
+};
+
+#endif // EXTERNALSORTER_H
@@ -1,17 +1,30 @@
 #include <QDirIterator>
 
+#include <algorithm>
+#include <optional>
+
 #include "FileCollector.h"
 #include "FileHasher.h"
+#include "PackJournal.h"
 
-FileCollector::FileCollector(const QString &rootPath)
+FileCollector::FileCollector(const QString &rootPath,
+                             qint64 maxMemory,
+                             PackJournal *journal,
+                             IoScheduler::ReadOrder readOrder)
     : m_rootPath{rootPath}
+    , m_maxMemory{maxMemory}
+    , m_journal{journal}
+    , m_readOrder{readOrder}
 {
     QFileInfo info{m_rootPath};\
 
     if (!info.exists() || !info.isDir())
         throw std::runtime_error(QString("Invalid directory: %1").arg(m_rootPath).toStdString());
 
-    scan();
+    if (m_maxMemory > s_unlimitedMemory)
+        scanBounded();
+    else
+        scan();
 }
 
 const QList<FileEntry> &FileCollector::getUniqueFiles() const
@@ -24,21 +37,207 @@ const QList<QList<FileEntry> > &FileCollector::getDuplicateFileGroups() const
     return m_duplicateFileGroups;
 }
 
+void FileCollector::setJournal(PackJournal *journal)
+{
+    m_journal = journal;
+}
+
+qint64 FileCollector::totalSize() const
+{
+    return m_totalSize;
+}
+
+bool FileCollector::forEachEntry(const EntryVisitor &visitor) const
+{
+    if (!m_sortedEntries)
+    {
+        qsizetype uniqueIndex{0};
+        qsizetype groupIndex{0};
+
+        // Unique files and groups are both in read order - merged, they are read in a single sweep, every group
+        // at the location of its leader
+        while (uniqueIndex < m_uniqueFiles.size() || groupIndex < m_duplicateFileGroups.size())
+        {
+            if (groupIndex == m_duplicateFileGroups.size()
+                || (uniqueIndex < m_uniqueFiles.size()
+                    && !IoScheduler::readsBefore(m_duplicateFileGroups.at(groupIndex).first(),
+                                                 m_uniqueFiles.at(uniqueIndex))))
+            {
+                if (!visitor(m_uniqueFiles.at(uniqueIndex++), true))
+                    return false;
+
+                continue;
+            }
+
+            const auto &group{m_duplicateFileGroups.at(groupIndex++)};
+
+            for (qsizetype i{0}; i < group.size(); ++i)
+            {
+                if (!visitor(group.at(i), i == 0))
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    return forEachGroupedEntry(*m_sortedEntries, visitor);
+}
+
 void FileCollector::scan()
 {
-    QHash<qint64, QList<FileEntry>> sizeGroups;
-    QDirIterator                    dirIterator{m_rootPath,
-                                                QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden,
-                                                QDirIterator::Subdirectories};
+    collect(m_rootPath);
+    group();
+}
+
+void FileCollector::update(const QSet<QString> &changedPaths)
+{
+    if (m_sortedEntries)
+        throw std::runtime_error(QString("Cannot update a bounded scan of: %1").arg(m_rootPath).toStdString());
+
+    QDir          rootDir{m_rootPath};
+    QSet<QString> replacedDirs;
+
+    for (const auto &relativePath : changedPaths)
+    {
+        QFileInfo info{rootDir.filePath(relativePath)};
+
+        if (info.isDir())
+        {
+            m_entries.remove(relativePath);
+            refreshBelow(relativePath);
+            continue;
+        }
+
+        // Anything but a collected file may have been a directory which was removed or replaced
+        if (!m_entries.contains(relativePath))
+            replacedDirs.insert(relativePath);
+
+        if (info.isFile())
+            refreshEntry(FileEntry{info, m_rootPath});
+        else
+            m_entries.remove(relativePath);
+    }
+
+    removeBelow(replacedDirs);
+    group();
+}
+
+QSet<QString> FileCollector::findChanges() const
+{
+    QSet<QString> changedPaths;
+    QSet<QString> foundPaths;
+    QDirIterator  dirIterator{m_rootPath,
+                             QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden,
+                             QDirIterator::Subdirectories};
 
-    // Group by file size first - prefiltering to find possible duplicates
     while (dirIterator.hasNext())
     {
-        QFileInfo fileInfo{dirIterator.next()};
-        FileEntry fileEntry{fileInfo, m_rootPath};
+        FileEntry current{QFileInfo{dirIterator.next()}, m_rootPath};
+
+        auto it{m_entries.constFind(current.relativePath())};
 
-        sizeGroups[fileEntry.size()].append(std::move(fileEntry));
+        if (it == m_entries.constEnd() || it->size() != current.size() || it->lastModified() != current.lastModified())
+            changedPaths.insert(current.relativePath());
+
+        foundPaths.insert(current.relativePath());
+    }
+
+    // Files which were not found anymore have been removed
+    for (auto it{m_entries.constBegin()}; it != m_entries.constEnd(); ++it)
+    {
+        if (!foundPaths.contains(it.key()))
+            changedPaths.insert(it.key());
+    }
+
+    return changedPaths;
+}
+
+void FileCollector::collect(const QString &dirPath)
+{
+    QDirIterator dirIterator{dirPath, QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden, QDirIterator::Subdirectories};
+
+    while (dirIterator.hasNext())
+    {
+        auto fileEntry{createEntry(dirIterator.next())};
+
+        m_entries.insert(fileEntry.relativePath(), fileEntry);
     }
+}
+
+void FileCollector::refreshEntry(const FileEntry &current)
+{
+    // Files which only had their attributes changed, or which lie in a directory reported as a whole, keep their hash
+    if (auto it{m_entries.constFind(current.relativePath())};
+        it != m_entries.constEnd() && it->size() == current.size() && it->lastModified() == current.lastModified())
+        return;
+
+    m_entries.insert(current.relativePath(), createEntry(current.path()));
+}
+
+void FileCollector::refreshBelow(const QString &relativeDirPath)
+{
+    QSet<QString> foundPaths;
+    QDirIterator  dirIterator{QDir{m_rootPath}.filePath(relativeDirPath),
+                             QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden,
+                             QDirIterator::Subdirectories};
+
+    while (dirIterator.hasNext())
+    {
+        FileEntry current{QFileInfo{dirIterator.next()}, m_rootPath};
+
+        foundPaths.insert(current.relativePath());
+        refreshEntry(current);
+    }
+
+    // Files below the directory which were not found anymore have been removed
+    auto prefix{relativeDirPath + '/'};
+
+    for (auto it{m_entries.begin()}; it != m_entries.end();)
+    {
+        if (it.key().startsWith(prefix) && !foundPaths.contains(it.key()))
+            it = m_entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+void FileCollector::removeBelow(const QSet<QString> &relativeDirPaths)
+{
+    if (relativeDirPaths.isEmpty())
+        return;
+
+    // A single pass over the entries, looking up each of their parent directories
+    for (auto it{m_entries.begin()}; it != m_entries.end();)
+    {
+        auto below{false};
+
+        for (auto slash{it.key().indexOf('/')}; slash >= 0 && !below; slash = it.key().indexOf('/', slash + 1))
+            below = relativeDirPaths.contains(it.key().left(slash));
+
+        if (below)
+            it = m_entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+void FileCollector::group()
+{
+    m_uniqueFiles.clear();
+    m_duplicateFileGroups.clear();
+    m_totalSize = 0;
+
+    QHash<qint64, QList<FileEntry>> sizeGroups;
+
+    // Group by file size first - prefiltering to find possible duplicates
+    for (const auto &fileEntry : std::as_const(m_entries))
+    {
+        m_totalSize += fileEntry.size();
+        sizeGroups[fileEntry.size()].append(fileEntry);
+    }
+
+    QList<FileEntry> filesToHash;
 
     // Iterate over each size group
     for (auto it{sizeGroups.constBegin()}; it != sizeGroups.constEnd(); ++it)
@@ -47,29 +246,202 @@ void FileCollector::scan()
 
         // Groups of size of 1 contain unique files only
         if (filesOfSameSize.size() == s_single)
-        {
             m_uniqueFiles.append(filesOfSameSize.first());
-            continue;
-        }
+        else
+            filesToHash.append(filesOfSameSize);
+    }
+
+    // Hash files that share the same size in disk order - compare their contents by calculated hashes
+    QHash<QPair<qint64, QByteArray>, QList<FileEntry>> hashGroups;
 
-        // Hash files that share the same size - compare their contents by calculated hashes
-        QHash<QByteArray, QList<FileEntry>> hashGroups;
+    IoScheduler::order(filesToHash);
 
-        for(auto file: filesOfSameSize)
+    for (auto &file : filesToHash)
+    {
+        // Files hashed before keep their hash until they change
+        if (file.hash().isEmpty())
         {
-            file.setHash(FileHasher::calculateHash(file.path()));
-            hashGroups[file.hash()].append(std::move(file));
+            hashFile(file);
+            m_entries[file.relativePath()].setHash(file.hash());
         }
 
-        // Group by hash and classify if files are unique or duplicates
-        for (auto hashIt{hashGroups.constBegin()}; hashIt != hashGroups.constEnd(); ++hashIt)
+        hashGroups[qMakePair(file.size(), file.hash())].append(std::move(file));
+    }
+
+    // Group by hash and classify if files are unique or duplicates
+    for (auto hashIt{hashGroups.constBegin()}; hashIt != hashGroups.constEnd(); ++hashIt)
+    {
+        const QList<FileEntry> &sameHashFiles{hashIt.value()};
+
+        if (sameHashFiles.size() == s_single)
+            m_uniqueFiles.append(sameHashFiles.first());
+        else
+            m_duplicateFileGroups.append(sameHashFiles);
+    }
+
+    // Contents are copied in disk order as well - groups are read through their leader
+    IoScheduler::order(m_uniqueFiles);
+    std::stable_sort(m_duplicateFileGroups.begin(),
+                     m_duplicateFileGroups.end(),
+                     [](const QList<FileEntry> &left, const QList<FileEntry> &right) {
+                         return IoScheduler::readsBefore(left.first(), right.first());
+                     });
+}
+
+void FileCollector::scanBounded()
+{
+    // Up to three sorters may hold their buffers at the same time - each gets a third of the budget
+    auto sorterBudget{qMax<qint64>(m_maxMemory / 3, 1)};
+    auto byContent{std::make_unique<ExternalSorter>(sorterBudget, contentLessThan)};
+
+    {
+        ExternalSorter toHash{sorterBudget, IoScheduler::readsBefore};
+
         {
-            const QList<FileEntry> &sameHashFiles{hashIt.value()};
+            ExternalSorter bySize{sorterBudget, [](const FileEntry &left, const FileEntry &right) {
+                return left.size() < right.size();
+            }};
+            QDirIterator   dirIterator{m_rootPath,
+                                       QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden,
+                                       QDirIterator::Subdirectories};
+
+            // Group by file size first - the sorter spills entries to disk once the budget is exceeded
+            while (dirIterator.hasNext())
+            {
+                auto fileEntry{createEntry(dirIterator.next())};
+
+                m_totalSize += fileEntry.size();
+                bySize.add(std::move(fileEntry));
+            }
+
+            bySize.finish();
+
+            // Files of the same size are adjacent now - only those which have a neighbour of equal size need hashing
+            std::optional<FileEntry> pending;
+            bool                     pendingHasTwin{false};
+
+            auto grouped{bySize.forEachSorted([&](const FileEntry &file) {
+                auto sameSize{pending && pending->size() == file.size()};
+
+                if (pending)
+                    (pendingHasTwin || sameSize ? toHash : *byContent).add(std::move(*pending));
+
+                pending = file;
+                pendingHasTwin = sameSize;
+
+                return true;
+            })};
+
+            if (!grouped)
+                throw std::runtime_error(QString("Failed reading spilled entries of: %1").arg(m_rootPath).toStdString());
+
+            if (pending)
+                (pendingHasTwin ? toHash : *byContent).add(std::move(*pending));
+        }
+
+        toHash.finish();
+
+        // Hash in disk order, so that the reads sweep across the disk
+        auto hashed{toHash.forEachSorted([&](const FileEntry &file) {
+            FileEntry current{file};
 
-            if (sameHashFiles.size() == s_single)
-                m_uniqueFiles.append(sameHashFiles.first());
-            else
-                m_duplicateFileGroups.append(sameHashFiles);
+            hashFile(current);
+            byContent->add(std::move(current));
+
+            return true;
+        })};
+
+        if (!hashed)
+            throw std::runtime_error(QString("Failed reading spilled entries of: %1").arg(m_rootPath).toStdString());
+    }
+
+    byContent->finish();
+
+    if (m_readOrder == IoScheduler::ReadOrder::Scan)
+    {
+        m_sortedEntries = std::move(byContent);
+        return;
+    }
+
+    // Contents are copied in disk order as well - every group sorts by the location of its leader,
+    // so that it stays contiguous
+    m_sortedEntries = std::make_unique<ExternalSorter>(sorterBudget, [](const FileEntry &left, const FileEntry &right) {
+        if (left.diskLocation() != right.diskLocation())
+            return IoScheduler::readsBefore(left, right);
+
+        return contentLessThan(left, right);
+    });
+
+    quint64 groupLocation{0};
+
+    auto ordered{forEachGroupedEntry(*byContent, [&](const FileEntry &file, bool isGroupLeader) {
+        FileEntry current{file};
+
+        if (isGroupLeader)
+            groupLocation = file.diskLocation();
+
+        current.setDiskLocation(groupLocation);
+        m_sortedEntries->add(std::move(current));
+
+        return true;
+    })};
+
+    if (!ordered)
+        throw std::runtime_error(QString("Failed reading spilled entries of: %1").arg(m_rootPath).toStdString());
+
+    m_sortedEntries->finish();
+}
+
+FileEntry FileCollector::createEntry(const QString &filePath) const
+{
+    FileEntry fileEntry{QFileInfo{filePath}, m_rootPath};
+
+    fileEntry.setDiskLocation(IoScheduler::diskLocation(fileEntry.path(), m_readOrder));
+
+    return fileEntry;
+}
+
+void FileCollector::hashFile(FileEntry &file) const
+{
+    // Hashes calculated before an interrupted pack are taken over for files which did not change since
+    if (m_journal)
+    {
+        if (auto cachedHash{m_journal->cachedHash(file)})
+        {
+            file.setHash(*cachedHash);
+            return;
         }
     }
+
+    file.setHash(FileHasher::calculateHash(file.path()));
+
+    if (m_journal && !file.hash().isEmpty())
+        m_journal->recordHash(file, file.hash());
+}
+
+bool FileCollector::forEachGroupedEntry(const ExternalSorter &sorter, const EntryVisitor &visitor)
+{
+    // Duplicates share their size, hash and sort position, so each group forms a contiguous range
+    qint64     groupSize{-1};
+    QByteArray groupHash;
+
+    return sorter.forEachSorted([&](const FileEntry &file) {
+        auto isGroupLeader{file.hash().isEmpty() || file.size() != groupSize || file.hash() != groupHash};
+
+        groupSize = file.size();
+        groupHash = file.hash();
+
+        return visitor(file, isGroupLeader);
+    });
+}
+
+bool FileCollector::contentLessThan(const FileEntry &left, const FileEntry &right)
+{
+    if (left.size() != right.size())
+        return left.size() < right.size();
+
+    if (left.hash() != right.hash())
+        return left.hash() < right.hash();
+
+    return left.relativePath() < right.relativePath();
 }
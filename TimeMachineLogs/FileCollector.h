@@ -1,23 +1,78 @@
 #ifndef FILECOLLECTOR_H
 #define FILECOLLECTOR_H
 
+#include <QHash>
+#include <QSet>
+
+#include <functional>
+#include <memory>
+
+#include "ExternalSorter.h"
 #include "FileEntry.h"
+#include "IoScheduler.h"
+
+class PackJournal;
 
 class FileCollector
 {
 public:
-    explicit FileCollector(const QString &rootPath);
+    // Receives every collected file - duplicates directly follow the file that leads their group
+    using EntryVisitor = std::function<bool(const FileEntry &file, bool isGroupLeader)>;
+
+    // A positive maxMemory bounds the scan's memory usage by spilling entries to disk - in that mode
+    // the collected files are only reachable through forEachEntry(). A journal provides and records hashes.
+    // Files are hashed and visited in the given read order, see IoScheduler
+    explicit FileCollector(const QString &rootPath,
+                           qint64 maxMemory = s_unlimitedMemory,
+                           PackJournal *journal = nullptr,
+                           IoScheduler::ReadOrder readOrder = IoScheduler::ReadOrder::Physical);
 
     const QList<FileEntry>        &getUniqueFiles() const;
     const QList<QList<FileEntry>> &getDuplicateFileGroups() const;
+    qint64                         totalSize() const; // Of all collected files, duplicates included
+
+    bool forEachEntry(const EntryVisitor &visitor) const;
+
+    // Brings the collected files up to date after the given paths, relative to the root, changed. Only new and
+    // modified files are hashed, along with files which now share their size with another one. Directories stand
+    // for everything below them - files whose size and modification time did not change keep their entries.
+    // Not available with a memory bound
+    void update(const QSet<QString> &changedPaths);
+
+    // Compares the tree with the collected files by size and modification time, without reading any file
+    QSet<QString> findChanges() const;
+
+    // Journal which later hashes are taken from and recorded in, none to detach it once its pack is finished
+    void setJournal(PackJournal *journal);
+
+    static constexpr qint64 s_unlimitedMemory{0};
 
 private:
-    void scan();
+    void      scan();
+    void      scanBounded();
+    void      collect(const QString &dirPath);
+    void      refreshEntry(const FileEntry &current);
+    void      refreshBelow(const QString &relativeDirPath);
+    void      removeBelow(const QSet<QString> &relativeDirPaths);
+    void      group();
+    void      hashFile(FileEntry &file) const;
+    FileEntry createEntry(const QString &filePath) const;
+
+    static bool forEachGroupedEntry(const ExternalSorter &sorter, const EntryVisitor &visitor);
+    static bool contentLessThan(const FileEntry &left, const FileEntry &right);
 
     QString                 m_rootPath;
+    qint64                  m_maxMemory;
+    PackJournal            *m_journal;
+    IoScheduler::ReadOrder  m_readOrder;
+    qint64                  m_totalSize{0};
+
+    QHash<QString, FileEntry> m_entries; // By relative path - hashes are kept across updates
     QList<FileEntry>        m_uniqueFiles;
     QList<QList<FileEntry>> m_duplicateFileGroups;
 
+    std::unique_ptr<ExternalSorter> m_sortedEntries;
+
     static constexpr qsizetype s_single{1};
 };
 
@@ -1,3 +1,4 @@
+#include <QDateTime>
 #include <QDir>
 
 #include "FileEntry.h"
@@ -7,6 +8,7 @@ FileEntry::FileEntry(const QFileInfo &fileInfo, const QString &rootPath)
     , m_path{fileInfo.absoluteFilePath()}
     , m_relativePath{QDir{rootPath}.relativeFilePath(m_path)}
     , m_size{fileInfo.size()}
+    , m_lastModified{fileInfo.lastModified().toMSecsSinceEpoch()}
     , m_hash{QByteArray{}}
 {
 }
@@ -31,6 +33,11 @@ qint64 FileEntry::size() const
     return m_size;
 }
 
+qint64 FileEntry::lastModified() const
+{
+    return m_lastModified;
+}
+
 void FileEntry::setHash(const QByteArray &hash)
 {
     m_hash = hash;
@@ -40,3 +47,39 @@ const QByteArray &FileEntry::hash() const
 {
     return m_hash;
 }
+
+void FileEntry::setDiskLocation(quint64 diskLocation)
+{
+    m_diskLocation = diskLocation;
+}
+
+quint64 FileEntry::diskLocation() const
+{
+    return m_diskLocation;
+}
+
+QDataStream &operator<<(QDataStream &out, const FileEntry &entry)
+{
+    out << entry.name();
+    out << entry.path();
+    out << entry.relativePath();
+    out << entry.size();
+    out << entry.lastModified();
+    out << entry.hash();
+    out << entry.diskLocation();
+
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, FileEntry &entry)
+{
+    in >> entry.m_name;
+    in >> entry.m_path;
+    in >> entry.m_relativePath;
+    in >> entry.m_size;
+    in >> entry.m_lastModified;
+    in >> entry.m_hash;
+    in >> entry.m_diskLocation;
+
+    return in;
+}
@@ -1,27 +1,40 @@
 #ifndef FILEENTRY_H
 #define FILEENTRY_H
 
+#include <QDataStream>
 #include <QFileInfo>
 
 class FileEntry
 {
 public:
+    FileEntry() = default;
     explicit FileEntry(const QFileInfo &fileInfo, const QString &rootPath);
 
     const QString &name() const;
     const QString &path() const;
     const QString &relativePath() const;
     qint64        size() const;
+    qint64        lastModified() const;
 
     void             setHash(const QByteArray &hash);
     const QByteArray &hash() const;
 
+    void    setDiskLocation(quint64 diskLocation);
+    quint64 diskLocation() const;
+
 private:
     QString    m_name;
     QString    m_path;
     QString    m_relativePath;
-    qint64     m_size;
+    qint64     m_size{0};
+    qint64     m_lastModified{0}; // Milliseconds since epoch
     QByteArray m_hash;
+    quint64    m_diskLocation{0}; // Read order key, see IoScheduler
+
+    friend QDataStream &operator>>(QDataStream &in, FileEntry &entry);
 };
 
+QDataStream &operator<<(QDataStream &out, const FileEntry &entry);
+QDataStream &operator>>(QDataStream &in, FileEntry &entry);
+
 #endif // FILEENTRY_H
@@ -1,3 +1,4 @@
+#include <QBuffer>
 #include <QFile>
 
 #include "FileHasher.h"
@@ -10,10 +11,24 @@ QByteArray FileHasher::calculateHash(const QString &filePath,
     if (!file.open(QIODevice::ReadOnly))
         return {};
 
+    return calculateHash(file, algorithm);
+}
+
+QByteArray FileHasher::calculateHash(QIODevice &device,
+                                     QCryptographicHash::Algorithm algorithm)
+{
+    if (auto *buffer{qobject_cast<QBuffer *>(&device)})
+        return QCryptographicHash::hash(buffer->data(), algorithm);
+
+    if (!device.seek(0))
+        return {};
+
     QCryptographicHash hasher{algorithm};
 
-    while (!file.atEnd())
-        hasher.addData(file.read(s_bufferSize));
+    while (!device.atEnd())
+        hasher.addData(device.read(s_bufferSize));
+
+    device.seek(0);
 
     return hasher.result();
 }
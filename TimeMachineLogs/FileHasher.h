@@ -2,12 +2,17 @@
 #define FILEHASHER_H
 
 #include <QCryptographicHash>
+#include <QIODevice>
 
 class FileHasher
 {
 public:
-    static QByteArray calculateHash(const QString &filePath,
-                                    QCryptographicHash::Algorithm algorithm = QCryptographicHash::Sha256);
+    static QByteArray calculateHash(const QString &filePath, QCryptographicHash::Algorithm algorithm = s_algorithm);
+
+    // Hashes the whole contents of an open device and rewinds it - in-memory buffers are hashed in place
+    static QByteArray calculateHash(QIODevice &device, QCryptographicHash::Algorithm algorithm = s_algorithm);
+
+    static constexpr QCryptographicHash::Algorithm s_algorithm{QCryptographicHash::Sha256};
 
 private:
     static constexpr int s_bufferSize{8192};
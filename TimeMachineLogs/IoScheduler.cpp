@@ -0,0 +1,95 @@
+#include <QFile>
+
+#include <algorithm>
+
+#include "IoScheduler.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+quint64 IoScheduler::diskLocation(const QString &filePath, ReadOrder readOrder)
+{
+    if (readOrder == ReadOrder::Scan)
+        return 0;
+
+    if (readOrder == ReadOrder::Physical)
+    {
+        if (auto offset{physicalOffset(filePath)})
+            return *offset & ~s_inodeRange;
+
+        // Inode numbers cannot be compared with byte offsets - files without extents follow all others,
+        // among themselves in inode order
+        if (auto inode{inodeNumber(filePath)})
+            return s_inodeRange | *inode;
+
+        return 0;
+    }
+
+    // Filesystems hand out inode numbers roughly in allocation order
+    return inodeNumber(filePath).value_or(0);
+}
+
+bool IoScheduler::readsBefore(const FileEntry &left, const FileEntry &right)
+{
+    return left.diskLocation() < right.diskLocation();
+}
+
+void IoScheduler::order(QList<FileEntry> &files)
+{
+    // Stable, so that files of unknown location keep the order in which they were found
+    std::stable_sort(files.begin(), files.end(), readsBefore);
+}
+
+std::optional<quint64> IoScheduler::physicalOffset(const QString &filePath)
+{
+#ifdef Q_OS_LINUX
+    QFile file{filePath};
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        return std::nullopt;
+
+    // Room for the request header and a single extent - only where the file starts matters
+    alignas(fiemap) char buffer[sizeof(fiemap) + sizeof(fiemap_extent)]{};
+    auto *request{reinterpret_cast<fiemap *>(buffer)};
+
+    request->fm_start = 0;
+    request->fm_length = FIEMAP_MAX_OFFSET;
+    request->fm_extent_count = 1;
+
+    if (::ioctl(file.handle(), FS_IOC_FIEMAP, request) != 0 || request->fm_mapped_extents == 0)
+        return std::nullopt;
+
+    // Data still waiting for delayed allocation has no physical location yet
+    if (request->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN)
+        return std::nullopt;
+
+    return request->fm_extents[0].fe_physical;
+#else
+    Q_UNUSED(filePath)
+
+    return std::nullopt;
+#endif
+}
+
+std::optional<quint64> IoScheduler::inodeNumber(const QString &filePath)
+{
+#ifdef Q_OS_UNIX
+    struct stat info;
+
+    if (::stat(QFile::encodeName(filePath).constData(), &info) != 0)
+        return std::nullopt;
+
+    return static_cast<quint64>(info.st_ino);
+#else
+    Q_UNUSED(filePath)
+
+    return std::nullopt;
+#endif
+}
@@ -0,0 +1,34 @@
+#ifndef IOSCHEDULER_H
+#define IOSCHEDULER_H
+
+#include <optional>
+
+#include "FileEntry.h"
+
+// Orders file reads by where the files lie on disk. Hashing and copying then sweep across the disk
+// instead of seeking back and forth between files, which dominates read times on spinning disks
+class IoScheduler
+{
+public:
+    enum class ReadOrder
+    {
+        Physical, // By the physical offset of a file's first extent, files without one follow by inode number
+        Inode,    // By inode number - files written together tend to be allocated together
+        Scan      // In the order files were found, i.e. unscheduled
+    };
+
+    // Sort key of a file, 0 when its location is unknown or the order is not scheduled
+    static quint64 diskLocation(const QString &filePath, ReadOrder readOrder);
+
+    static bool readsBefore(const FileEntry &left, const FileEntry &right);
+    static void order(QList<FileEntry> &files);
+
+private:
+    static std::optional<quint64> physicalOffset(const QString &filePath);
+    static std::optional<quint64> inodeNumber(const QString &filePath);
+
+    // Marks physical read order keys which fell back to the inode number, no disk is that large
+    static constexpr quint64 s_inodeRange{quint64{1} << 63};
+};
+
+#endif // IOSCHEDULER_H
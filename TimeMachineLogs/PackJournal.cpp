@@ -0,0 +1,390 @@
+#include <QDebug>
+#include <QFileInfo>
+
+#include "DiskSync.h"
+#include "PackJournal.h"
+
+PackJournal::PackJournal(const QString &archivePath, const QString &inputDir, const PackOptions &options)
+    : m_archivePath{archivePath}
+    , m_inputPath{QFileInfo{inputDir}.absoluteFilePath()}
+    , m_storePath{options.storePath.isEmpty() ? QString{} : QFileInfo{options.storePath}.absoluteFilePath()}
+    , m_indexTimestamps{options.indexTimestamps}
+    , m_journalFile{archivePath + s_journalSuffix}
+{
+}
+
+PackJournal::~PackJournal()
+{
+    // A pack which failed before any of its data became durable leaves nothing worth resuming
+    if (m_journalFile.isOpen() && m_checkpointOffset == 0)
+    {
+        m_journalFile.close();
+        m_journalFile.remove();
+    }
+}
+
+bool PackJournal::start()
+{
+    m_resumeOffset = 0;
+    m_checkpointOffset = 0;
+    m_cachedHashes.clear();
+    m_completedFiles.clear();
+    m_completedBlobs.clear();
+    m_removedPaths.clear();
+
+    return open(QIODevice::WriteOnly | QIODevice::Truncate);
+}
+
+bool PackJournal::resume()
+{
+    auto loaded{load()};
+
+    // Hashes and completed files of another input or blob store would end up in this archive
+    if (loaded == LoadResult::Mismatch)
+        return false;
+
+    if (loaded == LoadResult::Missing)
+    {
+        qInfo() << "No journal to resume from, packing from scratch: " << m_journalFile.fileName();
+        return start();
+    }
+
+    // The journal is rewritten compactly - records behind its last checkpoint are not valid anymore. The new one
+    // is staged next to it and replaces it by a rename, so that a crash while rewriting loses nothing
+    QFile rewritten{m_journalFile.fileName() + s_rewriteSuffix};
+
+    if (!rewritten.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Cannot rewrite pack journal: " << rewritten.fileName();
+        return false;
+    }
+
+    m_out.setDevice(&rewritten);
+    m_out.resetStatus();
+    writeHeader();
+
+    for (auto it{m_cachedHashes.constBegin()}; it != m_cachedHashes.constEnd(); ++it)
+    {
+        m_out << static_cast<quint8>(Record::Hash);
+        m_out << it.key() << it->size << it->lastModified << it->hash;
+    }
+
+    for (const auto &completed : std::as_const(m_completedFiles))
+    {
+        m_out << static_cast<quint8>(Record::File);
+        m_out << completed.lastModified << completed.meta;
+    }
+
+    for (const auto &removedPath : std::as_const(m_removedPaths))
+    {
+        m_out << static_cast<quint8>(Record::Removed);
+        m_out << removedPath;
+    }
+
+    m_out << static_cast<quint8>(Record::Checkpoint);
+    m_out << m_resumeOffset;
+
+    auto written{m_out.status() == QDataStream::Ok && DiskSync::syncFile(rewritten)};
+
+    m_out.setDevice(nullptr);
+    rewritten.close();
+
+    if (!written)
+    {
+        qWarning() << "Cannot rewrite pack journal: " << rewritten.fileName();
+        return false;
+    }
+
+    if (!DiskSync::replaceFile(rewritten.fileName(), m_journalFile.fileName())
+        || !DiskSync::syncDirectory(QFileInfo{m_journalFile.fileName()}.absolutePath()))
+        return false;
+
+    m_checkpointOffset = m_resumeOffset;
+
+    // Further records are appended to the rewritten journal
+    return open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+bool PackJournal::append(qint64 dataEnd,
+                         const QList<QPair<FileEntry, Archiver::FileMeta>> &keptFiles,
+                         const QStringList &removedPaths)
+{
+    if (!start())
+        return false;
+
+    for (const auto &[file, meta] : keptFiles)
+    {
+        CompletedFile completed{file.lastModified(), meta};
+
+        m_completedFiles.insert(meta.relativePath, completed);
+
+        if (!meta.hash.isEmpty())
+            m_completedBlobs.insert(meta.hash, meta);
+
+        m_out << static_cast<quint8>(Record::File);
+        m_out << completed.lastModified << completed.meta;
+    }
+
+    // Kept until the archive is complete, an interrupted append has to record the removals all the same
+    for (const auto &removedPath : removedPaths)
+    {
+        m_removedPaths.append(removedPath);
+
+        m_out << static_cast<quint8>(Record::Removed);
+        m_out << removedPath;
+    }
+
+    // The archive is complete up to its index, so the kept files are durable already
+    m_out << static_cast<quint8>(Record::Checkpoint);
+    m_out << dataEnd;
+
+    m_resumeOffset = dataEnd;
+    m_checkpointOffset = dataEnd;
+
+    return DiskSync::syncFile(m_journalFile);
+}
+
+qint64 PackJournal::resumeOffset() const
+{
+    return m_resumeOffset;
+}
+
+const QStringList &PackJournal::removedPaths() const
+{
+    return m_removedPaths;
+}
+
+std::optional<QByteArray> PackJournal::cachedHash(const FileEntry &file) const
+{
+    // Files modified since the interrupted run have to be hashed again
+    if (auto it{m_cachedHashes.constFind(file.relativePath())};
+        it != m_cachedHashes.constEnd() && it->size == file.size() && it->lastModified == file.lastModified())
+        return it->hash;
+
+    return std::nullopt;
+}
+
+void PackJournal::recordHash(const FileEntry &file, const QByteArray &hash)
+{
+    m_out << static_cast<quint8>(Record::Hash);
+    m_out << file.relativePath() << file.size() << file.lastModified() << hash;
+
+    flushPeriodically();
+}
+
+std::optional<Archiver::FileMeta> PackJournal::completedFile(const FileEntry &file) const
+{
+    if (auto it{m_completedFiles.constFind(file.relativePath())};
+        it != m_completedFiles.constEnd() && it->meta.size == file.size() && it->lastModified == file.lastModified())
+        return it->meta;
+
+    return std::nullopt;
+}
+
+std::optional<Archiver::FileMeta> PackJournal::completedBlob(const QByteArray &hash) const
+{
+    if (auto it{m_completedBlobs.constFind(hash)}; it != m_completedBlobs.constEnd())
+        return it.value();
+
+    return std::nullopt;
+}
+
+void PackJournal::recordFile(const FileEntry &file, const Archiver::FileMeta &meta)
+{
+    // Only becomes valid with the next checkpoint, once the data it points to is durable
+    m_out << static_cast<quint8>(Record::File);
+    m_out << file.lastModified() << meta;
+}
+
+bool PackJournal::dataWritten(QFile &archiveFile)
+{
+    if (m_sinceSync.elapsed() < s_syncInterval && archiveFile.pos() - m_checkpointOffset < s_checkpointBytes)
+        return true;
+
+    return checkpoint(archiveFile);
+}
+
+void PackJournal::finish()
+{
+    // The archive is complete - nothing is left to resume
+    m_journalFile.close();
+    m_journalFile.remove();
+}
+
+PackJournal::LoadResult PackJournal::load()
+{
+    QFile journalFile{m_journalFile.fileName()};
+
+    if (!journalFile.open(QIODevice::ReadOnly))
+        return LoadResult::Missing;
+
+    QDataStream in{&journalFile};
+    quint32     magic;
+    quint32     version;
+    QString     inputPath;
+    QString     storePath;
+    bool        indexTimestamps;
+
+    in >> magic >> version;
+
+    if (in.status() != QDataStream::Ok || magic != s_journalMagic || version != s_journalVersion)
+        return LoadResult::Missing;
+
+    in >> inputPath >> storePath >> indexTimestamps;
+
+    if (in.status() != QDataStream::Ok)
+        return LoadResult::Missing;
+
+    if (inputPath != m_inputPath || storePath != m_storePath || indexTimestamps != m_indexTimestamps)
+    {
+        qCritical() << "Journal belongs to a pack of" << inputPath << "with blob store" << storePath
+                    << "and time index" << indexTimestamps << "- resume it with the same options or remove it:"
+                    << m_journalFile.fileName();
+        return LoadResult::Mismatch;
+    }
+
+    QList<CompletedFile> pendingFiles;
+    QStringList          pendingRemovedPaths;
+
+    while (!in.atEnd())
+    {
+        quint8 record;
+
+        in >> record;
+
+        if (record == static_cast<quint8>(Record::Hash))
+        {
+            QString    relativePath;
+            CachedHash cached;
+
+            in >> relativePath >> cached.size >> cached.lastModified >> cached.hash;
+
+            if (in.status() == QDataStream::Ok)
+                m_cachedHashes.insert(relativePath, cached);
+        }
+        else if (record == static_cast<quint8>(Record::File))
+        {
+            CompletedFile completed;
+
+            in >> completed.lastModified >> completed.meta;
+
+            if (in.status() == QDataStream::Ok)
+                pendingFiles.append(completed);
+        }
+        else if (record == static_cast<quint8>(Record::Removed))
+        {
+            QString removedPath;
+
+            in >> removedPath;
+
+            if (in.status() == QDataStream::Ok)
+                pendingRemovedPaths.append(removedPath);
+        }
+        else if (record == static_cast<quint8>(Record::Checkpoint))
+        {
+            qint64 offset;
+
+            in >> offset;
+
+            if (in.status() != QDataStream::Ok)
+                break;
+
+            // Everything recorded up to a checkpoint refers to durable data
+            for (const auto &completed : std::as_const(pendingFiles))
+            {
+                m_completedFiles.insert(completed.meta.relativePath, completed);
+
+                if (!completed.meta.hash.isEmpty())
+                    m_completedBlobs.insert(completed.meta.hash, completed.meta);
+            }
+
+            // Removal records are written right behind the checkpoint of an append - any later checkpoint
+            // covers them, so that a resumed append does not write them again
+            m_removedPaths = pendingRemovedPaths;
+
+            pendingFiles.clear();
+            pendingRemovedPaths.clear();
+            m_resumeOffset = offset;
+        }
+        else
+        {
+            break;
+        }
+
+        // A record torn by the interruption ends the journal
+        if (in.status() != QDataStream::Ok)
+            break;
+    }
+
+    // Without the archive data the checkpoints point to, only the cached hashes are of use
+    if (QFileInfo{m_archivePath}.size() < m_resumeOffset)
+    {
+        qWarning() << "Archive is shorter than its journal expects, rewriting its data: " << m_archivePath;
+
+        m_resumeOffset = 0;
+        m_completedFiles.clear();
+        m_completedBlobs.clear();
+        m_removedPaths.clear();
+    }
+
+    return LoadResult::Loaded;
+}
+
+bool PackJournal::open(QIODevice::OpenMode mode)
+{
+    if (!m_journalFile.open(mode))
+    {
+        qWarning() << "Cannot open pack journal: " << m_journalFile.fileName();
+        return false;
+    }
+
+    // The journal may be started again, e.g. for every append in watch mode
+    m_out.setDevice(&m_journalFile);
+    m_out.resetStatus();
+    m_sinceSync.start();
+
+    // A journal which is appended to has its header already
+    if (!(mode & QIODevice::Append))
+        writeHeader();
+
+    return true;
+}
+
+void PackJournal::writeHeader()
+{
+    m_out << s_journalMagic << s_journalVersion;
+    m_out << m_inputPath << m_storePath << m_indexTimestamps;
+}
+
+bool PackJournal::checkpoint(QFile &archiveFile)
+{
+    // Archive data has to be on disk before a checkpoint claims it is
+    if (!DiskSync::syncFile(archiveFile))
+    {
+        qWarning() << "Cannot flush archive to disk: " << archiveFile.fileName();
+        return false;
+    }
+
+    m_out << static_cast<quint8>(Record::Checkpoint);
+    m_out << archiveFile.pos();
+
+    if (!DiskSync::syncFile(m_journalFile))
+    {
+        qWarning() << "Cannot flush pack journal to disk: " << m_journalFile.fileName();
+        return false;
+    }
+
+    m_checkpointOffset = archiveFile.pos();
+    m_sinceSync.restart();
+
+    return true;
+}
+
+void PackJournal::flushPeriodically()
+{
+    if (m_sinceSync.elapsed() < s_syncInterval)
+        return;
+
+    DiskSync::syncFile(m_journalFile);
+    m_sinceSync.restart();
+}
@@ -0,0 +1,105 @@
+#ifndef PACKJOURNAL_H
+#define PACKJOURNAL_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QStringList>
+
+#include <optional>
+
+#include "Archiver.h"
+
+// Progress journal kept next to an archive while it is being packed. It records the hashes calculated
+// so far and the files whose data is already in the archive. Checkpoints mark how much of the archive
+// is durable, so that an interrupted pack can be resumed from there instead of starting from zero
+class PackJournal
+{
+public:
+    // The input directory and the options are recorded, a journal of a pack with other ones is not resumed
+    PackJournal(const QString &archivePath, const QString &inputDir, const PackOptions &options);
+    ~PackJournal();
+
+    PackJournal(const PackJournal &) = delete;
+    PackJournal &operator=(const PackJournal &) = delete;
+
+    bool start();
+    bool resume(); // Fails for a journal of another input directory, blob store or time indexing
+
+    // Starts over from a complete archive whose file data ends at dataEnd. The kept files reuse their data,
+    // everything behind it is written anew. The removed paths are files of the archive which are gone since
+    bool append(qint64 dataEnd,
+                const QList<QPair<FileEntry, Archiver::FileMeta>> &keptFiles,
+                const QStringList &removedPaths);
+
+    qint64             resumeOffset() const;
+    const QStringList &removedPaths() const; // Whose removal records are still to be written at the resume offset
+
+    std::optional<QByteArray> cachedHash(const FileEntry &file) const;
+    void                      recordHash(const FileEntry &file, const QByteArray &hash);
+
+    std::optional<Archiver::FileMeta> completedFile(const FileEntry &file) const;
+    std::optional<Archiver::FileMeta> completedBlob(const QByteArray &hash) const;
+    void                              recordFile(const FileEntry &file, const Archiver::FileMeta &meta);
+
+    bool dataWritten(QFile &archiveFile);
+    void finish();
+
+private:
+    enum class LoadResult
+    {
+        Missing, // No journal, or none which can be read
+        Mismatch,
+        Loaded
+    };
+
+    enum class Record : quint8
+    {
+        Hash,
+        File,
+        Checkpoint,
+        Removed
+    };
+
+    struct CachedHash
+    {
+        qint64     size;
+        qint64     lastModified;
+        QByteArray hash;
+    };
+
+    struct CompletedFile
+    {
+        qint64             lastModified;
+        Archiver::FileMeta meta;
+    };
+
+    LoadResult load();
+    bool       open(QIODevice::OpenMode mode);
+    void       writeHeader();
+    bool       checkpoint(QFile &archiveFile);
+    void       flushPeriodically();
+
+    QString       m_archivePath;
+    QString       m_inputPath;
+    QString       m_storePath;
+    bool          m_indexTimestamps;
+    QFile         m_journalFile;
+    QDataStream   m_out;
+    QElapsedTimer m_sinceSync;
+    qint64        m_resumeOffset{0};
+    qint64        m_checkpointOffset{0};
+
+    QHash<QString, CachedHash>            m_cachedHashes;
+    QHash<QString, CompletedFile>         m_completedFiles;
+    QHash<QByteArray, Archiver::FileMeta> m_completedBlobs;
+    QStringList                           m_removedPaths;
+
+    static constexpr auto    s_journalSuffix{".journal"};
+    static constexpr auto    s_rewriteSuffix{".new"}; // Journal being rewritten, see resume()
+    static constexpr quint32 s_journalMagic{0x544D4C4A}; // "TMLJ"
+    static constexpr quint32 s_journalVersion{3};
+    static constexpr qint64  s_syncInterval{5000};                   // Milliseconds between checkpoints
+    static constexpr qint64  s_checkpointBytes{256 * 1024 * 1024};   // Archive data between checkpoints
+};
+
+#endif // PACKJOURNAL_H
@@ -0,0 +1,218 @@
+#include <QBuffer>
+#include <QDebug>
+
+#include <cstring>
+
+#include "SparseFileCopier.h"
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    qint64 alignDown(qint64 offset)
+    {
+        return offset - offset % SparseFileCopier::s_blockSize;
+    }
+
+    qint64 alignUp(qint64 offset)
+    {
+        return alignDown(offset + SparseFileCopier::s_blockSize - 1);
+    }
+}
+
+bool SparseFileCopier::copy(QIODevice &source, qint64 chunkSize, const DataWriter &writer, QList<Extent> &holes)
+{
+    auto   size{source.size()};
+    qint64 position{0};
+
+    // In-memory data is passed on where it is instead of being read into the buffer
+    auto      *memorySource{qobject_cast<QBuffer *>(&source)};
+    QByteArray buffer;
+
+    if (!memorySource)
+        buffer.resize(static_cast<int>(chunkSize));
+
+    while (position < size)
+    {
+        // Unallocated regions are skipped without reading them - rounded inwards to whole blocks
+        auto dataStart{alignDown(nextDataOffset(source, position, size))};
+
+        if (dataStart > position)
+        {
+            addHole(holes, position, dataStart - position);
+            position = dataStart;
+        }
+
+        // Read at least a block so that unaligned holes cannot stall the progress
+        auto dataEnd{qMin(qMax(alignUp(nextHoleOffset(source, position, size)), position + s_blockSize), size)};
+
+        if (!memorySource && !source.seek(position))
+        {
+            qWarning() << "Cannot seek in source: " << position;
+            return false;
+        }
+
+        while (position < dataEnd)
+        {
+            const char *data;
+            qint64      bytesRead;
+
+            if (memorySource)
+            {
+                data = memorySource->data().constData() + position;
+                bytesRead = qMin(chunkSize, dataEnd - position);
+            }
+            else
+            {
+                data = buffer.constData();
+                bytesRead = source.read(buffer.data(), qMin(chunkSize, dataEnd - position));
+            }
+
+            if (bytesRead <= 0)
+            {
+                qWarning() << "Unexpected end of source while reading at: " << position;
+                return false;
+            }
+
+            // Allocated data may still contain zero-filled blocks, e.g. of preallocated log files
+            qint64 dataBegin{0};
+
+            for (qint64 blockStart{0}; blockStart < bytesRead; blockStart += s_blockSize)
+            {
+                auto blockSize{qMin(s_blockSize, bytesRead - blockStart)};
+
+                if (blockSize < s_blockSize || !isZeroBlock(data + blockStart, blockSize))
+                    continue;
+
+                if (blockStart > dataBegin && !writer(position + dataBegin, data + dataBegin, blockStart - dataBegin))
+                    return false;
+
+                addHole(holes, position + blockStart, s_blockSize);
+                dataBegin = blockStart + s_blockSize;
+            }
+
+            if (bytesRead > dataBegin && !writer(position + dataBegin, data + dataBegin, bytesRead - dataBegin))
+                return false;
+
+            position += bytesRead;
+        }
+    }
+
+    return true;
+}
+
+bool SparseFileCopier::writeSparse(QFile &target, qint64 offset, const char *data, qint64 size)
+{
+    qint64 dataBegin{0};
+
+    auto writeData{[&](qint64 dataEnd) {
+        if (dataEnd <= dataBegin)
+            return true;
+
+        return target.seek(offset + dataBegin)
+               && target.write(data + dataBegin, dataEnd - dataBegin) == dataEnd - dataBegin;
+    }};
+
+    for (qint64 blockStart{0}; blockStart < size; blockStart += s_blockSize)
+    {
+        auto blockSize{qMin(s_blockSize, size - blockStart)};
+
+        if (blockSize < s_blockSize || !isZeroBlock(data + blockStart, blockSize))
+            continue;
+
+        // Zero blocks are not written at all - seeking over them leaves a hole in the target
+        if (!writeData(blockStart))
+            return false;
+
+        dataBegin = blockStart + s_blockSize;
+    }
+
+    return writeData(size);
+}
+
+bool SparseFileCopier::isZeroBlock(const char *data, qint64 size)
+{
+    // Comparing the block with itself shifted by one byte lets the vectorised memcmp do the scanning
+    return size > 0 && data[0] == 0 && std::memcmp(data, data + 1, static_cast<size_t>(size - 1)) == 0;
+}
+
+qint64 SparseFileCopier::nextDataOffset(QIODevice &source, qint64 offset, qint64 size)
+{
+#ifdef SEEK_DATA
+    auto handle{holeQueryHandle(source)};
+
+    if (handle < 0)
+        return offset;
+
+    if (auto dataOffset{::lseek(handle, offset, SEEK_DATA)}; dataOffset >= 0)
+        return dataOffset;
+
+    // No data behind the offset - the rest of the file is a hole
+    if (errno == ENXIO)
+        return size;
+#else
+    Q_UNUSED(source)
+    Q_UNUSED(size)
+#endif
+
+    // Filesystem cannot tell, every block has to be looked at
+    return offset;
+}
+
+qint64 SparseFileCopier::nextHoleOffset(QIODevice &source, qint64 offset, qint64 size)
+{
+#ifdef SEEK_HOLE
+    auto handle{holeQueryHandle(source)};
+
+    if (handle < 0)
+        return size;
+
+    if (auto holeOffset{::lseek(handle, offset, SEEK_HOLE)}; holeOffset >= 0)
+        return holeOffset;
+#else
+    Q_UNUSED(source)
+    Q_UNUSED(offset)
+#endif
+
+    return size;
+}
+
+int SparseFileCopier::holeQueryHandle(QIODevice &source)
+{
+    auto *file{qobject_cast<QFile *>(&source)};
+
+    // Only files are backed by a filesystem which knows about holes. Moving the handle of a buffered file
+    // would get it out of step with the data read ahead, such files are looked at block by block instead
+    if (!file || !file->openMode().testFlag(QIODevice::Unbuffered))
+        return -1;
+
+    return file->handle();
+}
+
+void SparseFileCopier::addHole(QList<Extent> &holes, qint64 offset, qint64 length)
+{
+    // Adjacent holes are merged, so that every hole is described by a single extent
+    if (!holes.isEmpty() && holes.last().offset + holes.last().length == offset)
+        holes.last().length += length;
+    else
+        holes.append(Extent{offset, length});
+}
+
+QDataStream &operator<<(QDataStream &out, const SparseFileCopier::Extent &extent)
+{
+    out << extent.offset;
+    out << extent.length;
+
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, SparseFileCopier::Extent &extent)
+{
+    in >> extent.offset;
+    in >> extent.length;
+
+    return in;
+}
@@ -0,0 +1,45 @@
+#ifndef SPARSEFILECOPIER_H
+#define SPARSEFILECOPIER_H
+
+#include <QDataStream>
+#include <QFile>
+
+#include <functional>
+
+// Copies file contents while leaving out holes - regions the filesystem reports as unallocated as well as
+// runs of zero-filled blocks. Holes always consist of whole, aligned blocks of s_blockSize bytes
+class SparseFileCopier
+{
+public:
+    struct Extent
+    {
+        qint64 offset;
+        qint64 length;
+    };
+
+    // Receives the data between holes, in order, together with its offset in the source file
+    using DataWriter = std::function<bool(qint64 offset, const char *data, qint64 size)>;
+
+    // The filesystem is queried for holes of files opened unbuffered, on their handle directly - other sources
+    // are checked block by block. In-memory sources (QBuffer) are handed to the writer straight from their data
+    static bool copy(QIODevice &source, qint64 chunkSize, const DataWriter &writer, QList<Extent> &holes);
+
+    // Writes data at the given offset, seeking over zero blocks so that the target ends up sparse.
+    // The target has to be resized to its final size once everything is written
+    static bool writeSparse(QFile &target, qint64 offset, const char *data, qint64 size);
+
+    static bool isZeroBlock(const char *data, qint64 size);
+
+    static constexpr qint64 s_blockSize{4096};
+
+private:
+    static qint64 nextDataOffset(QIODevice &source, qint64 offset, qint64 size);
+    static qint64 nextHoleOffset(QIODevice &source, qint64 offset, qint64 size);
+    static int    holeQueryHandle(QIODevice &source); // -1 for sources whose holes cannot be queried
+    static void   addHole(QList<Extent> &holes, qint64 offset, qint64 length);
+};
+
+QDataStream &operator<<(QDataStream &out, const SparseFileCopier::Extent &extent);
+QDataStream &operator>>(QDataStream &in, SparseFileCopier::Extent &extent);
+
+#endif // SPARSEFILECOPIER_H
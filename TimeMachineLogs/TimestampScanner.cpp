@@ -0,0 +1,321 @@
+#include <cstring>
+#include <limits>
+
+#include "TimestampScanner.h"
+
+namespace
+{
+    constexpr char s_monthNames[]{"JanFebMarAprMayJunJulAugSepOctNovDec"};
+
+    bool readNumber(const char *data, int digits, int &value)
+    {
+        value = 0;
+
+        for (auto i{0}; i < digits; ++i)
+        {
+            if (data[i] < '0' || data[i] > '9')
+                return false;
+
+            value = value * 10 + (data[i] - '0');
+        }
+
+        return true;
+    }
+
+    bool readMonthName(const char *data, int &month)
+    {
+        for (auto i{0}; i < 12; ++i)
+        {
+            if (std::memcmp(data, s_monthNames + i * 3, 3) == 0)
+            {
+                month = i + 1;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Reads HH:MM:SS or HH:MM (seconds optional) followed by an optional fraction of a second
+    bool readTime(const char *data, qsizetype length, int &hour, int &minute, int &second, int &msec)
+    {
+        second = 0;
+        msec = 0;
+
+        if (length < 5 || data[2] != ':' || !readNumber(data, 2, hour) || !readNumber(data + 3, 2, minute))
+            return false;
+
+        if (length < 8 || data[5] != ':')
+            return true;
+
+        if (!readNumber(data + 6, 2, second))
+            return false;
+
+        if (length > 9 && (data[8] == '.' || data[8] == ','))
+        {
+            auto scale{100};
+
+            for (qsizetype i{9}; i < length && i < 12 && data[i] >= '0' && data[i] <= '9'; ++i)
+            {
+                msec += (data[i] - '0') * scale;
+                scale /= 10;
+            }
+        }
+
+        return true;
+    }
+
+    // Skips brackets and indentation which commonly surround a leading timestamp
+    qsizetype timestampStart(const char *data, qsizetype length)
+    {
+        qsizetype start{0};
+
+        while (start < length && (data[start] == '[' || data[start] == ' ' || data[start] == '\t'))
+            ++start;
+
+        return start;
+    }
+}
+
+TimestampScanner::TimestampScanner(int year, YearOf yearOf)
+    : m_year{year}
+    , m_yearOf{yearOf}
+    , m_minTime{std::numeric_limits<qint64>::max()}
+    , m_maxTime{std::numeric_limits<qint64>::min()}
+{
+}
+
+void TimestampScanner::feed(const char *data, qint64 size)
+{
+    qint64 position{0};
+
+    // Complete the beginning of a line carried over from the previous chunk
+    if (!m_prefix.isEmpty())
+    {
+        auto       needed{qMin<qint64>(s_prefixLength - m_prefix.size(), size)};
+        const auto *lineBreak{static_cast<const char *>(std::memchr(data, '\n', needed))};
+        auto       length{lineBreak ? lineBreak - data : needed};
+
+        m_prefix.append(data, length);
+
+        if (!lineBreak && m_prefix.size() < s_prefixLength)
+            return;
+
+        scanLine(m_prefix.constData(), m_prefix.size());
+        m_prefix.clear();
+        position = length;
+    }
+
+    while (position < size)
+    {
+        // Only the beginning of a line is of interest - skip straight to the next line break
+        if (!m_atLineStart)
+        {
+            const auto *lineBreak{static_cast<const char *>(std::memchr(data + position, '\n', size - position))};
+
+            if (!lineBreak)
+                return;
+
+            position = lineBreak - data + 1;
+            m_atLineStart = true;
+            continue;
+        }
+
+        auto available{size - position};
+
+        // The line may continue in the next chunk - keep its beginning until enough of it arrives
+        if (available < s_prefixLength && !std::memchr(data + position, '\n', available))
+        {
+            m_prefix = QByteArray{data + position, available};
+            m_atLineStart = false;
+            return;
+        }
+
+        scanLine(data + position, qMin<qint64>(available, s_prefixLength));
+        m_atLineStart = false;
+    }
+}
+
+void TimestampScanner::finish()
+{
+    if (!m_prefix.isEmpty())
+        scanLine(m_prefix.constData(), m_prefix.size());
+
+    m_prefix.clear();
+
+    // Now that the number of year changes is known, the year of the first line is as well
+    auto firstYear{m_yearOf == YearOf::FirstLine ? m_year : m_year - m_rollovers};
+
+    for (const auto &time : {m_syslogMin, m_syslogMax})
+    {
+        if (!time)
+            continue;
+
+        const auto &[rollovers, month, day, hour, minute, second, msec]{*time};
+
+        if (auto converted{toEpochMsecs(firstYear + rollovers, month, day, hour, minute, second, msec)})
+            addTime(*converted);
+    }
+
+    m_syslogMin.reset();
+    m_syslogMax.reset();
+}
+
+bool TimestampScanner::hasRange() const
+{
+    return m_minTime <= m_maxTime;
+}
+
+qint64 TimestampScanner::minTime() const
+{
+    return m_minTime;
+}
+
+qint64 TimestampScanner::maxTime() const
+{
+    return m_maxTime;
+}
+
+std::optional<qint64> TimestampScanner::parseTimestamp(const char *data, qsizetype length, int defaultYear)
+{
+    auto start{timestampStart(data, length)};
+
+    if (auto time{parseIso(data + start, length - start)})
+        return time;
+
+    if (auto time{parseAccessLog(data + start, length - start)})
+        return time;
+
+    if (auto time{parseSyslog(data + start, length - start, defaultYear)})
+        return time;
+
+    // Access logs start with the client address, the timestamp follows in brackets
+    if (const auto *bracket{static_cast<const char *>(std::memchr(data, '[', length))})
+        return parseAccessLog(bracket + 1, length - (bracket + 1 - data));
+
+    return std::nullopt;
+}
+
+void TimestampScanner::scanLine(const char *data, qsizetype length)
+{
+    if (const auto *lineBreak{static_cast<const char *>(std::memchr(data, '\n', length))})
+        length = lineBreak - data;
+
+    // Syslog timestamps are kept apart until their year is known, the other formats cannot be taken for them
+    auto start{timestampStart(data, length)};
+
+    if (auto time{readSyslog(data + start, length - start)})
+        addSyslogTime(*time);
+    else if (auto time{parseTimestamp(data, length, m_year)})
+        addTime(*time);
+}
+
+void TimestampScanner::addSyslogTime(SyslogTime time)
+{
+    if (time.month < m_lastMonth)
+        ++m_rollovers;
+
+    m_lastMonth = time.month;
+    time.rollovers = m_rollovers;
+
+    if (!m_syslogMin || time.sortKey() < m_syslogMin->sortKey())
+        m_syslogMin = time;
+
+    if (!m_syslogMax || time.sortKey() > m_syslogMax->sortKey())
+        m_syslogMax = time;
+}
+
+void TimestampScanner::addTime(qint64 time)
+{
+    m_minTime = qMin(m_minTime, time);
+    m_maxTime = qMax(m_maxTime, time);
+}
+
+qint64 TimestampScanner::SyslogTime::sortKey() const
+{
+    // Fields in order of significance, each given room for its largest value
+    auto key{((static_cast<qint64>(rollovers) * 13 + month) * 32 + day) * 24 + hour};
+
+    return ((key * 60 + minute) * 61 + second) * 1000 + msec;
+}
+
+std::optional<qint64> TimestampScanner::parseIso(const char *data, qsizetype length)
+{
+    // 2024-05-17 02:13:45 - date and time separators are fixed, the fraction is optional
+    int year, month, day, hour, minute, second, msec;
+
+    if (length < 16 || (data[4] != '-' && data[4] != '/') || data[7] != data[4] || (data[10] != ' ' && data[10] != 'T'))
+        return std::nullopt;
+
+    if (!readNumber(data, 4, year) || !readNumber(data + 5, 2, month) || !readNumber(data + 8, 2, day))
+        return std::nullopt;
+
+    if (!readTime(data + 11, length - 11, hour, minute, second, msec))
+        return std::nullopt;
+
+    return toEpochMsecs(year, month, day, hour, minute, second, msec);
+}
+
+std::optional<qint64> TimestampScanner::parseSyslog(const char *data, qsizetype length, int defaultYear)
+{
+    auto time{readSyslog(data, length)};
+
+    if (!time)
+        return std::nullopt;
+
+    return toEpochMsecs(defaultYear, time->month, time->day, time->hour, time->minute, time->second, time->msec);
+}
+
+std::optional<TimestampScanner::SyslogTime> TimestampScanner::readSyslog(const char *data, qsizetype length)
+{
+    // May 17 02:13:45 - single digit days are padded with a space
+    SyslogTime time{};
+
+    if (length < 15 || data[3] != ' ' || data[6] != ' ' || !readMonthName(data, time.month))
+        return std::nullopt;
+
+    if (data[4] == ' ' ? !readNumber(data + 5, 1, time.day) : !readNumber(data + 4, 2, time.day))
+        return std::nullopt;
+
+    if (!readTime(data + 7, length - 7, time.hour, time.minute, time.second, time.msec))
+        return std::nullopt;
+
+    // Same bounds as toEpochMsecs(), so that only times which convert take part in the year count
+    if (time.day < 1 || time.day > 31 || time.hour > 23 || time.minute > 59 || time.second > 60)
+        return std::nullopt;
+
+    return time;
+}
+
+std::optional<qint64> TimestampScanner::parseAccessLog(const char *data, qsizetype length)
+{
+    // 17/May/2024:02:13:45 +0000
+    int year, month, day, hour, minute, second, msec;
+
+    if (length < 20 || data[2] != '/' || data[6] != '/' || data[11] != ':')
+        return std::nullopt;
+
+    if (!readNumber(data, 2, day) || !readMonthName(data + 3, month) || !readNumber(data + 7, 4, year))
+        return std::nullopt;
+
+    if (!readTime(data + 12, length - 12, hour, minute, second, msec))
+        return std::nullopt;
+
+    return toEpochMsecs(year, month, day, hour, minute, second, msec);
+}
+
+std::optional<qint64> TimestampScanner::toEpochMsecs(int year, int month, int day, int hour, int minute, int second, int msec)
+{
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+        return std::nullopt;
+
+    // Days since 1970-01-01 of the proleptic Gregorian calendar, without going through QDateTime
+    qint64 shiftedYear{month <= 2 ? year - 1 : year};
+    auto   era{(shiftedYear >= 0 ? shiftedYear : shiftedYear - 399) / 400};
+    auto   yearOfEra{shiftedYear - era * 400};
+    auto   dayOfYear{(153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1};
+    auto   dayOfEra{yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear};
+    auto   days{era * 146097 + dayOfEra - 719468};
+
+    return ((days * 24 + hour) * 60 + minute) * 60000 + second * 1000 + msec;
+}
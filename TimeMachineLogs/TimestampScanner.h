@@ -0,0 +1,76 @@
+#ifndef TIMESTAMPSCANNER_H
+#define TIMESTAMPSCANNER_H
+
+#include <QByteArray>
+
+#include <optional>
+
+// Tracks the range of event times found at the beginning of log lines. Content is fed chunk by chunk
+// as it is copied, so no additional read of the file is needed. Supported formats:
+//   2024-05-17 02:13:45.123 / 2024-05-17T02:13:45 / 2024/05/17 02:13:45   (ISO 8601 like)
+//   May 17 02:13:45                                                       (syslog, year counted on from the given one)
+//   [17/May/2024:02:13:45 +0000]                                          (Apache / nginx access logs)
+// Times are kept as written in the log, in milliseconds since epoch - time zone offsets are ignored
+class TimestampScanner
+{
+public:
+    // Line of the file which the year given for syslog timestamps belongs to. These carry no year - it is counted
+    // on whenever the month goes back from one line to the next, e.g. from Dec to Jan
+    enum class YearOf
+    {
+        FirstLine,
+        LastLine
+    };
+
+    TimestampScanner(int year, YearOf yearOf);
+
+    void feed(const char *data, qint64 size);
+    void finish();
+
+    bool   hasRange() const;
+    qint64 minTime() const;
+    qint64 maxTime() const;
+
+    static std::optional<qint64> parseTimestamp(const char *data, qsizetype length, int defaultYear);
+
+private:
+    struct SyslogTime
+    {
+        int rollovers; // Years passed since the first syslog line
+        int month;
+        int day;
+        int hour;
+        int minute;
+        int second;
+        int msec;
+
+        qint64 sortKey() const;
+    };
+
+    void scanLine(const char *data, qsizetype length);
+    void addSyslogTime(SyslogTime time);
+    void addTime(qint64 time);
+
+    static std::optional<SyslogTime> readSyslog(const char *data, qsizetype length);
+    static std::optional<qint64> parseIso(const char *data, qsizetype length);
+    static std::optional<qint64> parseSyslog(const char *data, qsizetype length, int defaultYear);
+    static std::optional<qint64> parseAccessLog(const char *data, qsizetype length);
+    static std::optional<qint64> toEpochMsecs(int year, int month, int day, int hour, int minute, int second, int msec);
+
+    int        m_year;
+    YearOf     m_yearOf;
+    bool       m_atLineStart{true};
+    QByteArray m_prefix; // Beginning of a line which continues in the next chunk
+    qint64     m_minTime;
+    qint64     m_maxTime;
+
+    // Syslog times only get their year once the file is finished, unless it is known from the first line
+    int                       m_rollovers{0};
+    int                       m_lastMonth{0};
+    std::optional<SyslogTime> m_syslogMin;
+    std::optional<SyslogTime> m_syslogMax;
+
+    static constexpr qsizetype s_prefixLength{64}; // Timestamps are only looked for this far into a line
+};
+
+#endif // TIMESTAMPSCANNER_H
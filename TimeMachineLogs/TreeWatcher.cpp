@@ -0,0 +1,245 @@
+#include <QDeadlineTimer>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QThread>
+
+#include "TreeWatcher.h"
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+namespace
+{
+    // Everything which changes a file's contents, metadata or presence - directories included
+    constexpr quint32 s_watchMask{IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE
+                                  | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR};
+}
+#endif
+
+TreeWatcher::TreeWatcher(const QString &rootPath)
+    : m_rootPath{QFileInfo{rootPath}.absoluteFilePath()}
+{
+#ifdef Q_OS_LINUX
+    m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (m_inotify < 0)
+    {
+        qWarning() << "Cannot watch directory tree, changes are looked for by rescanning it: " << rootPath;
+        return;
+    }
+
+    if (!addWatches(m_rootPath, nullptr))
+        stopWatching();
+#endif
+}
+
+TreeWatcher::~TreeWatcher()
+{
+#ifdef Q_OS_LINUX
+    if (m_inotify >= 0)
+        ::close(m_inotify);
+#endif
+}
+
+std::optional<QSet<QString>> TreeWatcher::waitForChanges(qint64 msecs)
+{
+#ifdef Q_OS_LINUX
+    if (m_inotify >= 0)
+    {
+        QSet<QString>  changedPaths;
+        QDeadlineTimer deadline{msecs};
+        auto           complete{true};
+
+        // Events are collected for the whole interval - a file written continuously is reported once
+        while (!deadline.hasExpired())
+        {
+            pollfd request{m_inotify, POLLIN, 0};
+            auto   ready{::poll(&request, 1, static_cast<int>(deadline.remainingTime()))};
+
+            if (ready < 0 && errno != EINTR)
+            {
+                stopWatching();
+                return std::nullopt;
+            }
+
+            if (ready > 0 && !readEvents(changedPaths))
+                complete = false;
+        }
+
+        if (!complete)
+            return std::nullopt;
+
+        return changedPaths;
+    }
+#endif
+
+    QThread::msleep(static_cast<unsigned long>(msecs));
+
+    return std::nullopt;
+}
+
+bool TreeWatcher::addWatches(const QString &dirPath, QSet<QString> *foundPaths)
+{
+    if (!addWatch(dirPath))
+        return false;
+
+    QDirIterator dirIterator{dirPath,
+                             QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden,
+                             QDirIterator::Subdirectories};
+
+    // Files which appeared before their directory was watched would go unnoticed otherwise
+    while (dirIterator.hasNext())
+    {
+        auto path{dirIterator.next()};
+        auto info{dirIterator.fileInfo()};
+
+        if (info.isDir() && !info.isSymLink())
+        {
+            if (!addWatch(path))
+                return false;
+        }
+        else if (foundPaths && info.isFile())
+        {
+            foundPaths->insert(relativePath(path));
+        }
+    }
+
+    return true;
+}
+
+bool TreeWatcher::addWatch(const QString &dirPath)
+{
+#ifdef Q_OS_LINUX
+    // A directory moved within the tree keeps its watch descriptor, only its path is updated
+    auto watch{::inotify_add_watch(m_inotify, QFile::encodeName(dirPath).constData(), s_watchMask)};
+
+    if (watch < 0)
+    {
+        // Directories removed meanwhile are reported through their parent
+        if (errno == ENOENT)
+            return true;
+
+        qWarning() << "Cannot watch directory, e.g. because of the inotify watch limit: " << dirPath;
+        return false;
+    }
+
+    m_watchedDirs.insert(watch, dirPath);
+
+    return true;
+#else
+    Q_UNUSED(dirPath)
+
+    return false;
+#endif
+}
+
+void TreeWatcher::removeWatches(const QString &dirPath)
+{
+#ifdef Q_OS_LINUX
+    auto prefix{dirPath + '/'};
+
+    for (auto it{m_watchedDirs.begin()}; it != m_watchedDirs.end();)
+    {
+        if (it.value() == dirPath || it.value().startsWith(prefix))
+        {
+            ::inotify_rm_watch(m_inotify, it.key());
+            it = m_watchedDirs.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+#else
+    Q_UNUSED(dirPath)
+#endif
+}
+
+bool TreeWatcher::readEvents(QSet<QString> &changedPaths)
+{
+#ifdef Q_OS_LINUX
+    alignas(inotify_event) char buffer[64 * 1024];
+    auto                        complete{true};
+    ssize_t                     length;
+
+    while ((length = ::read(m_inotify, buffer, sizeof(buffer))) > 0)
+    {
+        for (auto *position{buffer}; position < buffer + length;)
+        {
+            const auto *event{reinterpret_cast<const inotify_event *>(position)};
+
+            position += sizeof(inotify_event) + event->len;
+
+            // The kernel dropped events - which paths changed is not known anymore
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                complete = false;
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED)
+            {
+                m_watchedDirs.remove(event->wd);
+                continue;
+            }
+
+            auto dirIt{m_watchedDirs.constFind(event->wd)};
+
+            if (dirIt == m_watchedDirs.constEnd() || event->len == 0)
+                continue;
+
+            auto path{dirIt.value() + '/' + QFile::decodeName(event->name)};
+
+            if (event->mask & IN_ISDIR)
+            {
+                // The files found below a new directory are reported instead of it, so it is not walked again
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    if (!addWatches(path, &changedPaths))
+                    {
+                        stopWatching();
+                        return false;
+                    }
+
+                    continue;
+                }
+
+                if (event->mask & IN_MOVED_FROM)
+                    removeWatches(path);
+                else if (!(event->mask & IN_DELETE))
+                    continue; // Attributes of the directory itself, the files below it did not change
+            }
+
+            changedPaths.insert(relativePath(path));
+        }
+    }
+
+    return complete;
+#else
+    Q_UNUSED(changedPaths)
+
+    return false;
+#endif
+}
+
+void TreeWatcher::stopWatching()
+{
+#ifdef Q_OS_LINUX
+    qWarning() << "Stopped watching directory tree, changes are looked for by rescanning it: " << m_rootPath;
+
+    ::close(m_inotify);
+    m_inotify = -1;
+    m_watchedDirs.clear();
+#endif
+}
+
+QString TreeWatcher::relativePath(const QString &path) const
+{
+    return QDir{m_rootPath}.relativeFilePath(path);
+}
@@ -0,0 +1,39 @@
+#ifndef TREEWATCHER_H
+#define TREEWATCHER_H
+
+#include <QHash>
+#include <QSet>
+
+#include <optional>
+
+// Reports which paths below a directory tree changed, so that the tree does not have to be rescanned to
+// find them. On Linux every directory of the tree is watched through inotify. Elsewhere, or when the
+// events cannot be relied on, the changes are unknown and the caller has to look for them itself
+class TreeWatcher
+{
+public:
+    explicit TreeWatcher(const QString &rootPath);
+    ~TreeWatcher();
+
+    TreeWatcher(const TreeWatcher &) = delete;
+    TreeWatcher &operator=(const TreeWatcher &) = delete;
+
+    // Waits for the given number of milliseconds and returns the paths changed meanwhile, relative to the root.
+    // Removed directories stand for everything below them, new ones are reported by the files found in them.
+    // Empty when the changes are unknown
+    std::optional<QSet<QString>> waitForChanges(qint64 msecs);
+
+private:
+    bool    addWatches(const QString &dirPath, QSet<QString> *foundPaths);
+    bool    addWatch(const QString &dirPath);
+    void    removeWatches(const QString &dirPath);
+    bool    readEvents(QSet<QString> &changedPaths);
+    void    stopWatching();
+    QString relativePath(const QString &path) const;
+
+    QString             m_rootPath;
+    int                 m_inotify{-1};
+    QHash<int, QString> m_watchedDirs; // Watch descriptor to directory path
+};
+
+#endif // TREEWATCHER_H
@@ -1,12 +1,27 @@
 #include <QCommandLineOption>
 #include <QCommandLineParser>
 #include <QCoreApplication>
+#include <QDate>
 #include <QDebug>
 
+#include <cstdio>
+#include <limits>
+#include <optional>
+
 #include "FileCollector.h"
 #include "ApplicationConstants.h"
 #include "ArchiverModeHelper.h"
 #include "Archiver.h"
+#include "ArchiveSearcher.h"
+#include "ArchiveWatcher.h"
+#include "IoScheduler.h"
+#include "PackJournal.h"
+#include "TimestampScanner.h"
+
+#ifdef Q_OS_WIN
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 static const QCommandLineOption modeOption{
     QStringList() << ApplicationConstants::MODE_SHORT << ApplicationConstants::MODE_LONG,
@@ -26,13 +41,136 @@ static const QCommandLineOption outputOption{
     ApplicationConstants::OUTPUT_LONG
 };
 
+static const QCommandLineOption maxMemoryOption{
+    QStringList() << ApplicationConstants::MAX_MEMORY_LONG,
+    ApplicationConstants::MAX_MEMORY_DESCRIPTION,
+    ApplicationConstants::MAX_MEMORY_LONG
+};
+
+static const QCommandLineOption storeOption{
+    QStringList() << ApplicationConstants::STORE_SHORT << ApplicationConstants::STORE_LONG,
+    ApplicationConstants::STORE_DESCRIPTION,
+    ApplicationConstants::STORE_LONG
+};
+
+static const QCommandLineOption patternOption{
+    QStringList() << ApplicationConstants::PATTERN_SHORT << ApplicationConstants::PATTERN_LONG,
+    ApplicationConstants::PATTERN_DESCRIPTION,
+    ApplicationConstants::PATTERN_LONG
+};
+
+static const QCommandLineOption regexOption{
+    QStringList() << ApplicationConstants::REGEX_LONG,
+    ApplicationConstants::REGEX_DESCRIPTION
+};
+
+static const QCommandLineOption timeIndexOption{
+    QStringList() << ApplicationConstants::TIME_INDEX_LONG,
+    ApplicationConstants::TIME_INDEX_DESCRIPTION
+};
+
+static const QCommandLineOption fromOption{
+    QStringList() << ApplicationConstants::FROM_LONG,
+    ApplicationConstants::FROM_DESCRIPTION,
+    ApplicationConstants::FROM_LONG
+};
+
+static const QCommandLineOption toOption{
+    QStringList() << ApplicationConstants::TO_LONG,
+    ApplicationConstants::TO_DESCRIPTION,
+    ApplicationConstants::TO_LONG
+};
+
+static const QCommandLineOption resumeOption{
+    QStringList() << ApplicationConstants::RESUME_LONG,
+    ApplicationConstants::RESUME_DESCRIPTION
+};
+
+static const QCommandLineOption readOrderOption{
+    QStringList() << ApplicationConstants::READ_ORDER_LONG,
+    ApplicationConstants::READ_ORDER_DESCRIPTION,
+    ApplicationConstants::READ_ORDER_LONG
+};
+
+static const QCommandLineOption intervalOption{
+    QStringList() << ApplicationConstants::INTERVAL_LONG,
+    ApplicationConstants::INTERVAL_DESCRIPTION,
+    ApplicationConstants::INTERVAL_LONG
+};
+
+static const QCommandLineOption snapshotOption{
+    QStringList() << ApplicationConstants::SNAPSHOT_LONG,
+    ApplicationConstants::SNAPSHOT_DESCRIPTION
+};
+
 struct CommandLineArguments
 {
     ArchiverMode mode;
     QString      input;
     QString      output;
+    qint64       maxMemory{FileCollector::s_unlimitedMemory};
+    QString      storePath;
+    QString      pattern;
+    bool         regularExpression{false};
+    bool         indexTimestamps{false};
+    bool         resume{false};
+    bool         snapshot{false};
+    qint64       interval{WatchOptions::s_interval};
+
+    std::optional<IoScheduler::ReadOrder> readOrder{IoScheduler::ReadOrder::Physical};
+
+    std::optional<qint64> fromTime;
+    std::optional<qint64> toTime;
 };
 
+// Parses sizes like "1048576", "512K", "256M" or "2G" into bytes, returns -1 when invalid
+qint64 parseMemorySize(const QString &sizeString)
+{
+    auto   value{sizeString.trimmed().toUpper()};
+    qint64 multiplier{1};
+
+    if (auto suffixIndex{QString{ApplicationConstants::MEMORY_SUFFIXES}.indexOf(value.right(1))};
+        !value.isEmpty() && suffixIndex >= 0)
+    {
+        multiplier = qint64{1} << (10 * (suffixIndex + 1));
+        value.chop(1);
+    }
+
+    bool ok;
+    auto size{value.toLongLong(&ok)};
+
+    // Sizes which do not fit into 64 bits once the suffix is applied are as invalid as malformed ones
+    if (!ok || size <= 0 || size > std::numeric_limits<qint64>::max() / multiplier)
+        return -1;
+
+    return size * multiplier;
+}
+
+// Parses a point in time given in any of the formats understood by TimestampScanner
+std::optional<qint64> parseTime(const QString &timeString)
+{
+    auto data{timeString.trimmed().toUtf8()};
+
+    return TimestampScanner::parseTimestamp(data.constData(), data.size(), QDate::currentDate().year());
+}
+
+// Parses the name of a read order, see IoScheduler
+std::optional<IoScheduler::ReadOrder> parseReadOrder(const QString &readOrderString)
+{
+    auto value{readOrderString.trimmed().toLower()};
+
+    if (value == ApplicationConstants::READ_ORDER_PHYSICAL)
+        return IoScheduler::ReadOrder::Physical;
+
+    if (value == ApplicationConstants::READ_ORDER_INODE)
+        return IoScheduler::ReadOrder::Inode;
+
+    if (value == ApplicationConstants::READ_ORDER_SCAN)
+        return IoScheduler::ReadOrder::Scan;
+
+    return std::nullopt;
+}
+
 CommandLineArguments parseArguments(const QCommandLineParser &parser)
 {
     CommandLineArguments args;
@@ -42,10 +180,54 @@ CommandLineArguments parseArguments(const QCommandLineParser &parser)
     args.mode = ArchiverModeHelper::stringToMode(modeString);
     args.input = parser.value(inputOption);
     args.output = parser.value(outputOption);
+    args.storePath = parser.value(storeOption);
+    args.pattern = parser.value(patternOption);
+    args.regularExpression = parser.isSet(regexOption);
+    args.indexTimestamps = parser.isSet(timeIndexOption);
+    args.resume = parser.isSet(resumeOption);
+    args.snapshot = parser.isSet(snapshotOption);
+
+    if (parser.isSet(fromOption))
+        args.fromTime = parseTime(parser.value(fromOption));
+
+    if (parser.isSet(toOption))
+        args.toTime = parseTime(parser.value(toOption));
+
+    if (parser.isSet(maxMemoryOption))
+        args.maxMemory = parseMemorySize(parser.value(maxMemoryOption));
+
+    if (parser.isSet(readOrderOption))
+        args.readOrder = parseReadOrder(parser.value(readOrderOption));
+
+    if (parser.isSet(intervalOption))
+    {
+        bool ok;
+        auto seconds{parser.value(intervalOption).toLongLong(&ok)};
+
+        args.interval = ok && seconds > 0 ? seconds * 1000 : -1;
+    }
 
     return args;
 }
 
+// Unpacks an archive piped to the application, e.g. straight from a backup stream
+bool unpackStandardInput(const QString &outputDir, const UnpackOptions &options)
+{
+#ifdef Q_OS_WIN
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+
+    QFile standardInput;
+
+    if (!standardInput.open(stdin, QIODevice::ReadOnly))
+    {
+        qCritical() << "Cannot read from standard input.";
+        return false;
+    }
+
+    return Archiver::unpackStream(standardInput, outputDir, options);
+}
+
 void setupApplication(QCoreApplication &app)
 {
     app.setApplicationName(ApplicationConstants::APPLICATION_NAME);
@@ -54,7 +236,9 @@ void setupApplication(QCoreApplication &app)
 
 QList<QCommandLineOption> getCommandLineOptions()
 {
-    return QList<QCommandLineOption>{modeOption, inputOption, outputOption};
+    return QList<QCommandLineOption>{modeOption, inputOption, outputOption, maxMemoryOption, storeOption,
+                                     patternOption, regexOption, timeIndexOption, fromOption, toOption,
+                                     resumeOption, readOrderOption, intervalOption, snapshotOption};
 }
 
 void setupCommandLineParser(QCommandLineParser &parser)
@@ -67,7 +251,11 @@ void setupCommandLineParser(QCommandLineParser &parser)
 
 bool validateArguments(const QCommandLineParser &parser, char *argv[])
 {
-    if (!parser.isSet(modeOption) || !parser.isSet(inputOption) || !parser.isSet(outputOption))
+    // Search mode prints its results instead of producing an output
+    auto isSearch{ArchiverModeHelper::stringToMode(parser.value(modeOption)) == ArchiverMode::Search};
+    auto hasTarget{isSearch ? parser.isSet(patternOption) : parser.isSet(outputOption)};
+
+    if (!parser.isSet(modeOption) || !parser.isSet(inputOption) || !hasTarget)
     {
         qCritical() << "Error: Missing required arguments";
         qCritical() << "Usage examples:";
@@ -79,6 +267,14 @@ bool validateArguments(const QCommandLineParser &parser, char *argv[])
                     << " " << ApplicationConstants::MODE_UNPACK
                     << " --" << ApplicationConstants::INPUT_LONG << " archive.zip"
                     << " --" << ApplicationConstants::OUTPUT_LONG << " /path/to/directory";
+        qCritical() << " " << argv[0] << " --" << ApplicationConstants::MODE_LONG
+                    << " " << ApplicationConstants::MODE_SEARCH
+                    << " --" << ApplicationConstants::INPUT_LONG << " archive.zip"
+                    << " --" << ApplicationConstants::PATTERN_LONG << " text";
+        qCritical() << " " << argv[0] << " --" << ApplicationConstants::MODE_LONG
+                    << " " << ApplicationConstants::MODE_WATCH
+                    << " --" << ApplicationConstants::INPUT_LONG << " /path/to/directory"
+                    << " --" << ApplicationConstants::OUTPUT_LONG << " archive.zip";
         qCritical() << "";
         qCritical() << "Use --help for more information";
 
@@ -93,8 +289,10 @@ bool validateMode(const ArchiverMode mode)
     if (!ArchiverModeHelper::isValidMode(mode))
     {
         qCritical() << "Error: Invalid mode. Use '"
-                    << ApplicationConstants::MODE_PACK << "' or '"
-                    << ApplicationConstants::MODE_UNPACK << "'";
+                    << ApplicationConstants::MODE_PACK << "', '"
+                    << ApplicationConstants::MODE_UNPACK << "', '"
+                    << ApplicationConstants::MODE_SEARCH << "' or '"
+                    << ApplicationConstants::MODE_WATCH << "'";
 
         return false;
     }
@@ -145,15 +343,77 @@ int main(int argc, char *argv[])
     if (!validateMode(args.mode))
         return 1;
 
+    if (args.maxMemory < 0)
+    {
+        qCritical() << "Error: Invalid memory budget:" << parser.value(maxMemoryOption);
+        return 1;
+    }
+
+    if ((parser.isSet(fromOption) && !args.fromTime) || (parser.isSet(toOption) && !args.toTime))
+    {
+        qCritical() << "Error: Invalid time window:" << parser.value(fromOption) << parser.value(toOption);
+        return 1;
+    }
+
+    if (!args.readOrder)
+    {
+        qCritical() << "Error: Invalid read order:" << parser.value(readOrderOption);
+        return 1;
+    }
+
+    if (args.interval < 0)
+    {
+        qCritical() << "Error: Invalid interval:" << parser.value(intervalOption);
+        return 1;
+    }
+
+    // The journal's hashes and completed files are looked up in memory, which a memory budget rules out
+    if (args.resume && args.maxMemory > FileCollector::s_unlimitedMemory)
+    {
+        qCritical() << "Error: Resuming is not supported together with a memory budget";
+        return 1;
+    }
+
+    // Watch mode keeps the collected files in memory to update them
+    if (args.mode == ArchiverModeHelper::Mode::Watch && args.maxMemory > FileCollector::s_unlimitedMemory)
+    {
+        qCritical() << "Error: Memory budget is not supported in watch mode";
+        return 1;
+    }
+
     try
     {
         if (args.mode == ArchiverModeHelper::Mode::Pack)
         {
-            FileCollector fileCollector{args.input};
-            const auto    &uniqueFiles{fileCollector.getUniqueFiles()};
-            const auto    &duplicateFileGroups{fileCollector.getDuplicateFileGroups()};
+            PackOptions options;
+
+            options.storePath = args.storePath;
+            options.indexTimestamps = args.indexTimestamps;
 
-            if (!Archiver::pack(args.output, uniqueFiles, duplicateFileGroups))
+            // The journal lets a pack interrupted by a crash or reboot continue where it stopped. Its checkpoints
+            // flush the archive to disk, so it is only kept when asked for
+            std::optional<PackJournal> journal;
+
+            if (args.resume)
+            {
+                // The journal is kept next to the archive, whose directory may not exist yet
+                if (!Archiver::validateArchivePathForPack(args.output))
+                    return 1;
+
+                journal.emplace(args.output, args.input, options);
+
+                if (!journal->resume())
+                {
+                    qCritical() << "Failed to resume the pack journal for:" << args.output;
+                    return 1;
+                }
+
+                options.journal = &*journal;
+            }
+
+            FileCollector fileCollector{args.input, args.maxMemory, options.journal, *args.readOrder};
+
+            if (!Archiver::pack(args.output, fileCollector, options))
             {
                 qCritical() << "Failed to pack the archive:" << args.output;
                 return 1;
@@ -161,12 +421,52 @@ int main(int argc, char *argv[])
         }
         else if (args.mode == ArchiverModeHelper::Mode::Unpack)
         {
-            if (!Archiver::unpack(args.input, args.output))
+            UnpackOptions options;
+
+            options.storePath = args.storePath;
+            options.fromTime = args.fromTime;
+            options.toTime = args.toTime;
+
+            auto unpacked{args.input == ApplicationConstants::STANDARD_INPUT
+                              ? unpackStandardInput(args.output, options)
+                              : Archiver::unpack(args.input, args.output, options)};
+
+            if (!unpacked)
             {
                 qCritical() << "Failed to unpack the archive:" << args.input;
                 return 1;
             }
         }
+        else if (args.mode == ArchiverModeHelper::Mode::Search)
+        {
+            SearchOptions options;
+
+            options.storePath = args.storePath;
+            options.regularExpression = args.regularExpression;
+
+            if (!ArchiveSearcher::search(args.input, args.pattern, options))
+            {
+                qCritical() << "Failed to search the archive:" << args.input;
+                return 1;
+            }
+        }
+        else if (args.mode == ArchiverModeHelper::Mode::Watch)
+        {
+            WatchOptions options;
+
+            options.pack.storePath = args.storePath;
+            options.pack.indexTimestamps = args.indexTimestamps;
+            options.interval = args.interval;
+            options.snapshot = args.snapshot;
+            options.resume = args.resume;
+            options.readOrder = *args.readOrder;
+
+            if (!ArchiveWatcher::watch(args.input, args.output, options))
+            {
+                qCritical() << "Failed to keep the archive up to date:" << args.output;
+                return 1;
+            }
+        }
     }
     catch (std::exception &e)
     {
@@ -0,0 +1,116 @@
+#ifndef TESTTREE_H
+#define TESTTREE_H
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QMap>
+#include <QSet>
+
+// Directory trees for the tests - written from and read back into a map of relative path to contents,
+// so that what was packed can be compared with what was unpacked
+namespace TestTree
+{
+    using Files = QMap<QString, QByteArray>;
+
+    inline bool writeFile(const QString &rootPath, const QString &relativePath, const QByteArray &contents)
+    {
+        auto filePath{QDir{rootPath}.filePath(relativePath)};
+
+        if (!QDir().mkpath(QFileInfo{filePath}.path()))
+            return false;
+
+        QFile file{filePath};
+
+        return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(contents) == contents.size();
+    }
+
+    inline bool writeTree(const QString &rootPath, const Files &files)
+    {
+        for (auto it{files.constBegin()}; it != files.constEnd(); ++it)
+        {
+            if (!writeFile(rootPath, it.key(), it.value()))
+                return false;
+        }
+
+        return true;
+    }
+
+    inline Files readTree(const QString &rootPath)
+    {
+        Files        files;
+        QDir         root{rootPath};
+        QDirIterator it{rootPath, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories};
+
+        while (it.hasNext())
+        {
+            auto  filePath{it.next()};
+            QFile file{filePath};
+
+            if (file.open(QIODevice::ReadOnly))
+                files.insert(root.relativeFilePath(filePath), file.readAll());
+        }
+
+        return files;
+    }
+
+    // Lines with a leading timestamp, different for every seed
+    inline QByteArray logContents(int seed, int lineCount)
+    {
+        QByteArray contents;
+
+        for (auto line{0}; line < lineCount; ++line)
+        {
+            contents += "2024-05-17 02:13:45.123 worker-" + QByteArray::number(seed) + " handled request "
+                        + QByteArray::number(line) + "\n";
+        }
+
+        return contents;
+    }
+
+    // Text around a run of zero blocks, which the archive leaves out as a hole
+    inline QByteArray sparseContents()
+    {
+        return "header\n" + QByteArray(8 * 4096, '\0') + "trailer\n";
+    }
+
+    // Duplicates, a hole, an empty file and data spanning several chunks of s_chunkSize
+    inline Files sampleFiles()
+    {
+        return Files{{"app/server.log", logContents(1, 4000)},
+                     {"app/server.log.1", logContents(1, 4000)},
+                     {"app/old.log", logContents(2, 100)},
+                     {"db/query.log", logContents(3, 500)},
+                     {"db/sparse.bin", sparseContents()},
+                     {"empty.log", {}}};
+    }
+
+    // Sample files after an update which modifies, adds and removes one file each
+    inline Files changedSampleFiles()
+    {
+        auto files{sampleFiles()};
+
+        files.remove("app/old.log");
+        files.insert("db/query.log", logContents(3, 600));
+        files.insert("db/new.log", logContents(5, 300));
+
+        return files;
+    }
+
+    // Applies the update to a tree of the sample files, returning the changed paths
+    inline QSet<QString> changeSampleTree(const QString &rootPath)
+    {
+        auto files{changedSampleFiles()};
+
+        if (!QFile::remove(QDir{rootPath}.filePath("app/old.log"))
+            || !writeFile(rootPath, "db/query.log", files.value("db/query.log"))
+            || !writeFile(rootPath, "db/new.log", files.value("db/new.log")))
+            return {};
+
+        return {"app/old.log", "db/query.log", "db/new.log"};
+    }
+
+    static constexpr qint64 s_chunkSize{16 * 1024}; // Small chunks, so that files are copied in several of them
+}
+
+#endif // TESTTREE_H
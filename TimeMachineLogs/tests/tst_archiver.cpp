@@ -0,0 +1,231 @@
+#include <QBuffer>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+#include <vector>
+
+#include "Archiver.h"
+#include "FileCollector.h"
+#include "PackJournal.h"
+#include "TestTree.h"
+
+class TestArchiver : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void packUnpackRoundTrip();
+    void packUnpackStreamRoundTrip();
+    void packUnpackInMemoryRoundTrip();
+    void appendUnpackRoundTrip();
+    void appendCompactsDeadData();
+
+private:
+    QString inputPath() const;
+    QString outputPath() const;
+    QString archivePath() const;
+
+    static PackOptions   packOptions();
+    static UnpackOptions unpackOptions();
+
+    std::unique_ptr<QTemporaryDir> m_workDir;
+};
+
+void TestArchiver::init()
+{
+    m_workDir = std::make_unique<QTemporaryDir>();
+
+    QVERIFY(m_workDir->isValid());
+    QVERIFY(TestTree::writeTree(inputPath(), TestTree::sampleFiles()));
+}
+
+void TestArchiver::packUnpackRoundTrip()
+{
+    FileCollector fileCollector{inputPath()};
+
+    QVERIFY(Archiver::pack(archivePath(), fileCollector, packOptions()));
+    QVERIFY(Archiver::unpack(archivePath(), outputPath(), unpackOptions()));
+
+    QCOMPARE(TestTree::readTree(outputPath()), TestTree::sampleFiles());
+}
+
+void TestArchiver::packUnpackStreamRoundTrip()
+{
+    FileCollector fileCollector{inputPath()};
+
+    QVERIFY(Archiver::pack(archivePath(), fileCollector, packOptions()));
+
+    QFile archiveFile{archivePath()};
+
+    QVERIFY(archiveFile.open(QIODevice::ReadOnly));
+    QVERIFY(Archiver::unpackStream(archiveFile, outputPath(), unpackOptions()));
+
+    QCOMPARE(TestTree::readTree(outputPath()), TestTree::sampleFiles());
+}
+
+void TestArchiver::packUnpackInMemoryRoundTrip()
+{
+    auto files{TestTree::sampleFiles()};
+
+    // Buffers are packed in place, a buffered file has its holes found by reading it
+    std::vector<std::unique_ptr<QBuffer>> buffers;
+    QList<Archiver::Source>               sources;
+    QFile                                 sparseFile{QDir{inputPath()}.filePath("db/sparse.bin")};
+
+    QVERIFY(sparseFile.open(QIODevice::ReadOnly));
+
+    for (auto it{files.begin()}; it != files.end(); ++it)
+    {
+        if (it.key() == "db/sparse.bin")
+        {
+            sources.append(Archiver::Source{it.key(), &sparseFile});
+            continue;
+        }
+
+        const auto &buffer{buffers.emplace_back(std::make_unique<QBuffer>(&it.value()))};
+
+        QVERIFY(buffer->open(QIODevice::ReadOnly));
+        sources.append(Archiver::Source{it.key(), buffer.get()});
+    }
+
+    QBuffer archive;
+
+    QVERIFY(archive.open(QIODevice::ReadWrite));
+    QVERIFY(Archiver::pack(archive, sources, packOptions()));
+
+    TestTree::Files unpacked;
+
+    QVERIFY(archive.seek(0));
+    QVERIFY(Archiver::unpack(archive,
+                             [&](const Archiver::FileMeta &meta, QIODevice &contents) {
+                                 unpacked.insert(meta.relativePath, contents.readAll());
+                                 return true;
+                             },
+                             unpackOptions()));
+
+    QCOMPARE(unpacked, files);
+}
+
+void TestArchiver::appendUnpackRoundTrip()
+{
+    FileCollector fileCollector{inputPath()};
+
+    QVERIFY(Archiver::pack(archivePath(), fileCollector, packOptions()));
+
+    QList<Archiver::FileMeta> packedFiles;
+
+    QVERIFY(Archiver::readIndex(archivePath(), packedFiles));
+
+    auto changedPaths{TestTree::changeSampleTree(inputPath())};
+
+    QVERIFY(!changedPaths.isEmpty());
+
+    fileCollector.update(changedPaths);
+
+    auto        options{packOptions()};
+    PackJournal journal{archivePath(), inputPath(), options};
+
+    options.journal = &journal;
+
+    QVERIFY(Archiver::append(archivePath(), fileCollector, changedPaths, options));
+    QVERIFY(!QFileInfo::exists(archivePath() + ".journal"));
+
+    // Unchanged files keep the data they were packed with
+    QList<Archiver::FileMeta> appendedFiles;
+
+    QVERIFY(Archiver::readIndex(archivePath(), appendedFiles));
+
+    for (const auto &packed : std::as_const(packedFiles))
+    {
+        for (const auto &appended : std::as_const(appendedFiles))
+        {
+            if (appended.relativePath == packed.relativePath && !changedPaths.contains(packed.relativePath))
+                QCOMPARE(appended.dataOffset, packed.dataOffset);
+        }
+    }
+
+    QVERIFY(Archiver::unpack(archivePath(), outputPath(), unpackOptions()));
+    QCOMPARE(TestTree::readTree(outputPath()), TestTree::changedSampleFiles());
+
+    // Sequential readers restore the files as first packed, then apply the update, removal included
+    auto  streamOutputPath{m_workDir->filePath("stream")};
+    QFile archiveFile{archivePath()};
+
+    QVERIFY(archiveFile.open(QIODevice::ReadOnly));
+    QVERIFY(Archiver::unpackStream(archiveFile, streamOutputPath, unpackOptions()));
+    QCOMPARE(TestTree::readTree(streamOutputPath), TestTree::changedSampleFiles());
+}
+
+void TestArchiver::appendCompactsDeadData()
+{
+    FileCollector fileCollector{inputPath()};
+
+    QVERIFY(Archiver::pack(archivePath(), fileCollector, packOptions()));
+
+    // The largest files make up most of the data - once they change, the archive is rewritten
+    auto files{TestTree::sampleFiles()};
+
+    files.insert("app/server.log", TestTree::logContents(6, 4000));
+    files.insert("app/server.log.1", TestTree::logContents(6, 4000));
+
+    QVERIFY(TestTree::writeTree(inputPath(), files));
+
+    QSet<QString> changedPaths{"app/server.log", "app/server.log.1"};
+
+    fileCollector.update(changedPaths);
+
+    auto        options{packOptions()};
+    PackJournal journal{archivePath(), inputPath(), options};
+
+    options.journal = &journal;
+
+    QVERIFY(Archiver::append(archivePath(), fileCollector, changedPaths, options));
+    QVERIFY(!QFileInfo::exists(archivePath() + ".compact"));
+
+    // No removal or replaced records are left for sequential readers either
+    QFile archiveFile{archivePath()};
+
+    QVERIFY(archiveFile.open(QIODevice::ReadOnly));
+    QVERIFY(Archiver::unpackStream(archiveFile, outputPath(), unpackOptions()));
+    QCOMPARE(TestTree::readTree(outputPath()), files);
+}
+
+QString TestArchiver::inputPath() const
+{
+    return m_workDir->filePath("input");
+}
+
+QString TestArchiver::outputPath() const
+{
+    return m_workDir->filePath("output");
+}
+
+QString TestArchiver::archivePath() const
+{
+    return m_workDir->filePath("logs.tml");
+}
+
+PackOptions TestArchiver::packOptions()
+{
+    PackOptions options;
+
+    options.chunkSize = TestTree::s_chunkSize;
+
+    return options;
+}
+
+UnpackOptions TestArchiver::unpackOptions()
+{
+    UnpackOptions options;
+
+    options.chunkSize = TestTree::s_chunkSize;
+
+    return options;
+}
+
+QTEST_GUILESS_MAIN(TestArchiver)
+
+#include "tst_archiver.moc"
@@ -0,0 +1,110 @@
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+#include "Archiver.h"
+#include "BlobStore.h"
+#include "FileCollector.h"
+#include "FileHasher.h"
+#include "TestTree.h"
+
+class TestBlobStore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void putReadBack();
+    void putRejectsMismatchedHash();
+    void packUnpackThroughStore();
+
+private:
+    QString inputPath() const;
+    QString storePath() const;
+
+    std::unique_ptr<QTemporaryDir> m_workDir;
+};
+
+void TestBlobStore::init()
+{
+    m_workDir = std::make_unique<QTemporaryDir>();
+
+    QVERIFY(m_workDir->isValid());
+    QVERIFY(TestTree::writeTree(inputPath(), TestTree::sampleFiles()));
+}
+
+void TestBlobStore::putReadBack()
+{
+    BlobStore blobStore{storePath()};
+
+    // Holes are left unallocated in the blob, but read back as zeros
+    for (const auto &relativePath : {"app/server.log", "db/sparse.bin", "empty.log"})
+    {
+        auto filePath{QDir{inputPath()}.filePath(relativePath)};
+        auto hash{FileHasher::calculateHash(filePath)};
+
+        QVERIFY(!blobStore.contains(hash));
+        QVERIFY(blobStore.put(hash, filePath, TestTree::s_chunkSize));
+        QVERIFY(blobStore.contains(hash));
+
+        QFile blob{blobStore.blobPath(hash)};
+
+        QVERIFY(blob.open(QIODevice::ReadOnly));
+        QCOMPARE(blob.readAll(), TestTree::sampleFiles().value(relativePath));
+    }
+}
+
+void TestBlobStore::putRejectsMismatchedHash()
+{
+    BlobStore blobStore{storePath()};
+
+    // E.g. a file written to between being hashed and being stored
+    auto filePath{QDir{inputPath()}.filePath("db/query.log")};
+    auto staleHash{FileHasher::calculateHash(filePath)};
+
+    QVERIFY(TestTree::writeFile(inputPath(), "db/query.log", TestTree::logContents(4, 500)));
+
+    QVERIFY(!blobStore.put(staleHash, filePath, TestTree::s_chunkSize));
+    QVERIFY(!blobStore.contains(staleHash));
+}
+
+void TestBlobStore::packUnpackThroughStore()
+{
+    PackOptions   packOptions;
+    UnpackOptions unpackOptions;
+
+    packOptions.storePath = storePath();
+    packOptions.chunkSize = TestTree::s_chunkSize;
+    unpackOptions.storePath = storePath();
+    unpackOptions.chunkSize = TestTree::s_chunkSize;
+
+    FileCollector fileCollector{inputPath()};
+
+    // The second archive finds every blob stored by the first one
+    for (const auto &archiveName : {"first.tml", "second.tml"})
+    {
+        auto archivePath{m_workDir->filePath(archiveName)};
+        auto outputPath{m_workDir->filePath(QString{archiveName} + ".out")};
+
+        QVERIFY(Archiver::pack(archivePath, fileCollector, packOptions));
+        QVERIFY(Archiver::unpack(archivePath, outputPath, unpackOptions));
+
+        QCOMPARE(TestTree::readTree(outputPath), TestTree::sampleFiles());
+    }
+}
+
+QString TestBlobStore::inputPath() const
+{
+    return m_workDir->filePath("input");
+}
+
+QString TestBlobStore::storePath() const
+{
+    return m_workDir->filePath("store");
+}
+
+QTEST_GUILESS_MAIN(TestBlobStore)
+
+#include "tst_blobstore.moc"
@@ -0,0 +1,177 @@
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+#include "Archiver.h"
+#include "FileCollector.h"
+#include "PackJournal.h"
+#include "TestTree.h"
+
+class TestPackJournal : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void resumeAfterTornData();
+    void resumeAfterTruncationBelowCheckpoint();
+    void resumeRefusesOtherSettings();
+
+private:
+    void interruptAppend();
+    void resumeAndUnpack();
+
+    QString inputPath() const;
+    QString archivePath() const;
+    QString journalPath() const;
+
+    static PackOptions   packOptions();
+    static UnpackOptions unpackOptions();
+
+    std::unique_ptr<QTemporaryDir> m_workDir;
+    std::unique_ptr<FileCollector> m_fileCollector;
+    qint64                         m_packedSize{0}; // Of the archive before the append
+};
+
+void TestPackJournal::init()
+{
+    m_workDir = std::make_unique<QTemporaryDir>();
+
+    QVERIFY(m_workDir->isValid());
+    QVERIFY(TestTree::writeTree(inputPath(), TestTree::sampleFiles()));
+
+    interruptAppend();
+}
+
+void TestPackJournal::resumeAfterTornData()
+{
+    // Cuts into the records written behind the checkpoint, the kept data stays whole
+    QVERIFY(QFileInfo{archivePath()}.size() > m_packedSize);
+    QVERIFY(QFile::resize(archivePath(), m_packedSize));
+
+    resumeAndUnpack();
+}
+
+void TestPackJournal::resumeAfterTruncationBelowCheckpoint()
+{
+    // The journal's completed files point to data which is gone, the archive has to be written anew
+    QVERIFY(QFile::resize(archivePath(), m_packedSize / 2));
+
+    resumeAndUnpack();
+}
+
+void TestPackJournal::resumeRefusesOtherSettings()
+{
+    auto otherInputPath{m_workDir->filePath("other")};
+
+    QVERIFY(TestTree::writeTree(otherInputPath, TestTree::changedSampleFiles()));
+
+    PackJournal otherInput{archivePath(), otherInputPath, packOptions()};
+
+    QVERIFY(!otherInput.resume());
+
+    auto storeOptions{packOptions()};
+
+    storeOptions.storePath = m_workDir->filePath("store");
+
+    PackJournal otherStore{archivePath(), inputPath(), storeOptions};
+
+    QVERIFY(!otherStore.resume());
+
+    // Refusing leaves the journal for a resume with the right settings
+    QVERIFY(QFileInfo::exists(journalPath()));
+
+    resumeAndUnpack();
+}
+
+void TestPackJournal::interruptAppend()
+{
+    m_fileCollector = std::make_unique<FileCollector>(inputPath());
+
+    QVERIFY(Archiver::pack(archivePath(), *m_fileCollector, packOptions()));
+
+    m_packedSize = QFileInfo{archivePath()}.size();
+
+    auto changedPaths{TestTree::changeSampleTree(inputPath())};
+
+    QVERIFY(!changedPaths.isEmpty());
+
+    m_fileCollector->update(changedPaths);
+
+    // Cancelled once every file is written, right before the index - as if the process was killed there
+    auto        options{packOptions()};
+    PackJournal journal{archivePath(), inputPath(), options};
+
+    options.journal = &journal;
+    options.progress = [](qint64 processedBytes, qint64 totalBytes) {
+        return processedBytes < totalBytes;
+    };
+
+    QVERIFY(!Archiver::append(archivePath(), *m_fileCollector, changedPaths, options));
+    QVERIFY(QFileInfo::exists(journalPath()));
+}
+
+void TestPackJournal::resumeAndUnpack()
+{
+    auto        options{packOptions()};
+    PackJournal journal{archivePath(), inputPath(), options};
+
+    QVERIFY(journal.resume());
+
+    options.journal = &journal;
+
+    QVERIFY(Archiver::pack(archivePath(), *m_fileCollector, options));
+    QVERIFY(!QFileInfo::exists(journalPath()));
+
+    auto outputPath{m_workDir->filePath("output")};
+
+    QVERIFY(Archiver::unpack(archivePath(), outputPath, unpackOptions()));
+    QCOMPARE(TestTree::readTree(outputPath), TestTree::changedSampleFiles());
+
+    // The removal records of the interrupted append have to be written by the resumed one
+    auto  streamOutputPath{m_workDir->filePath("stream")};
+    QFile archiveFile{archivePath()};
+
+    QVERIFY(archiveFile.open(QIODevice::ReadOnly));
+    QVERIFY(Archiver::unpackStream(archiveFile, streamOutputPath, unpackOptions()));
+    QCOMPARE(TestTree::readTree(streamOutputPath), TestTree::changedSampleFiles());
+}
+
+QString TestPackJournal::inputPath() const
+{
+    return m_workDir->filePath("input");
+}
+
+QString TestPackJournal::archivePath() const
+{
+    return m_workDir->filePath("logs.tml");
+}
+
+QString TestPackJournal::journalPath() const
+{
+    return archivePath() + ".journal";
+}
+
+PackOptions TestPackJournal::packOptions()
+{
+    PackOptions options;
+
+    options.chunkSize = TestTree::s_chunkSize;
+
+    return options;
+}
+
+UnpackOptions TestPackJournal::unpackOptions()
+{
+    UnpackOptions options;
+
+    options.chunkSize = TestTree::s_chunkSize;
+
+    return options;
+}
+
+QTEST_GUILESS_MAIN(TestPackJournal)
+
+#include "tst_packjournal.moc"